@@ -0,0 +1,126 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  batch-alloc.cpp
+ * @brief Compares hoard_malloc_batch and hoard_free_batch with loops of
+ *        single mallocs and frees.
+ *
+ * For each size, repeatedly allocates a batch of objects, touches
+ * each one, and frees them all, first one call at a time and then
+ * with the batch calls (looked up at run time, so the benchmark runs
+ * under any allocator; without Hoard, only the loops are timed).
+ *
+ *  batch-alloc <iterations> <batch> [<object-size> ...]
+ *
+ *  batch-alloc 200 100000 16 48 128
+ */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace std::chrono;
+
+int niterations = 200;
+int batchSize = 100000;
+
+typedef size_t (* mallocBatchFunction) (size_t, size_t, void **);
+typedef void (* freeBatchFunction) (void **, size_t);
+
+mallocBatchFunction mallocBatch;
+freeBatchFunction freeBatch;
+
+// Sets mallocTime and freeTime to the seconds spent in each.
+void run (size_t objSize, bool batched, double& mallocTime, double& freeTime)
+{
+  vector<void *> objs (batchSize);
+  mallocTime = 0;
+  freeTime = 0;
+  for (int i = 0; i < niterations; i++) {
+    auto start = steady_clock::now();
+    if (batched) {
+      if (mallocBatch (objSize, batchSize, objs.data()) != (size_t) batchSize) {
+	abort();
+      }
+    } else {
+      for (int j = 0; j < batchSize; j++) {
+	objs[j] = malloc (objSize);
+      }
+    }
+    auto middle = steady_clock::now();
+    for (int j = 0; j < batchSize; j++) {
+      *((char *) objs[j]) = (char) j;
+    }
+    auto touched = steady_clock::now();
+    if (batched) {
+      freeBatch (objs.data(), batchSize);
+    } else {
+      for (int j = 0; j < batchSize; j++) {
+	free (objs[j]);
+      }
+    }
+    auto end = steady_clock::now();
+    mallocTime += duration_cast<duration<double>>(middle - start).count();
+    freeTime += duration_cast<duration<double>>(end - touched).count();
+  }
+}
+
+int main (int argc, char * argv[])
+{
+  if (argc >= 2) {
+    niterations = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    batchSize = atoi(argv[2]);
+  }
+  vector<size_t> sizes;
+  for (int i = 3; i < argc; i++) {
+    sizes.push_back (atoi(argv[i]));
+  }
+  if (sizes.empty()) {
+    sizes = { 16, 48, 128 };
+  }
+
+  mallocBatch = (mallocBatchFunction) dlsym (RTLD_DEFAULT, "hoard_malloc_batch");
+  freeBatch = (freeBatchFunction) dlsym (RTLD_DEFAULT, "hoard_free_batch");
+
+  printf ("Running batch-alloc for %d iterations, batch %d...\n",
+	  niterations, batchSize);
+
+  const double objects = (double) niterations * batchSize;
+  for (auto sz : sizes) {
+    double mallocTime, freeTime;
+    // Warm up, so that superblocks are already in place.
+    run (sz, false, mallocTime, freeTime);
+    run (sz, false, mallocTime, freeTime);
+    cout << "Object size " << sz << ", single calls: "
+	 << mallocTime * 1e9 / objects << " ns per malloc, "
+	 << freeTime * 1e9 / objects << " ns per free" << endl;
+    if (mallocBatch && freeBatch) {
+      run (sz, true, mallocTime, freeTime);
+      cout << "Object size " << sz << ", batch calls:  "
+	   << mallocTime * 1e9 / objects << " ns per malloc, "
+	   << freeTime * 1e9 / objects << " ns per free" << endl;
+    }
+  }
+
+  return 0;
+}
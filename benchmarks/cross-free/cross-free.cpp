@@ -0,0 +1,137 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  cross-free.cpp
+ * @brief Measures cross-thread frees: producers allocate, consumers free.
+ *
+ * Each of <pairs> producer threads allocates batches of objects and
+ * hands them to its own consumer thread, which frees them. The
+ * producer keeps allocating from the same superblocks the consumer is
+ * freeing into, so this exposes any sharing between the owner's
+ * allocation state and the state that remote frees write.
+ *
+ *  cross-free <pairs> <iterations> <batch> <object-size>
+ *
+ *  cross-free 1 20000 256 64
+ *  cross-free P/2 20000 256 64
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace std::chrono;
+
+int npairs = 1;
+int niterations = 20000;
+int batchSize = 256;
+int objSize = 64;
+
+// A single-slot mailbox from a producer to its consumer.
+struct alignas(64) Mailbox {
+  atomic<char **> batch { nullptr };
+};
+
+void producer (Mailbox * box)
+{
+  // Double-buffer so that the producer can fill one batch while the
+  // consumer frees the other.
+  vector<char *> buf[2] = { vector<char *>(batchSize), vector<char *>(batchSize) };
+  for (int i = 0; i < niterations; i++) {
+    auto& b = buf[i & 1];
+    for (int j = 0; j < batchSize; j++) {
+      b[j] = (char *) malloc (objSize);
+      b[j][0] = (char) j;
+    }
+    char ** expected = nullptr;
+    while (!box->batch.compare_exchange_weak (expected, b.data(), memory_order_release, memory_order_relaxed)) {
+      expected = nullptr;
+      this_thread::yield();
+    }
+  }
+  // Wait for the consumer to drain the last batch, then tell it to stop.
+  char ** expected = nullptr;
+  while (!box->batch.compare_exchange_weak (expected, (char **) box, memory_order_release, memory_order_relaxed)) {
+    expected = nullptr;
+    this_thread::yield();
+  }
+}
+
+void consumer (Mailbox * box)
+{
+  for (;;) {
+    auto * b = box->batch.load (memory_order_acquire);
+    if (b == nullptr) {
+      this_thread::yield();
+      continue;
+    }
+    if (b == (char **) box) {
+      return;
+    }
+    for (int j = 0; j < batchSize; j++) {
+      free (b[j]);
+    }
+    box->batch.store (nullptr, memory_order_release);
+  }
+}
+
+int main (int argc, char * argv[])
+{
+  if (argc >= 2) {
+    npairs = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    niterations = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    batchSize = atoi(argv[3]);
+  }
+  if (argc >= 5) {
+    objSize = atoi(argv[4]);
+  }
+
+  printf ("Running cross-free for %d pairs, %d iterations, batch %d, object size %d...\n",
+	  npairs, niterations, batchSize, objSize);
+
+  vector<Mailbox> boxes (npairs);
+  vector<thread> threads;
+
+  high_resolution_clock t;
+  auto start = t.now();
+
+  for (int i = 0; i < npairs; i++) {
+    threads.emplace_back (consumer, &boxes[i]);
+    threads.emplace_back (producer, &boxes[i]);
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+
+  auto stop = t.now();
+  auto elapsed = duration_cast<duration<double>>(stop - start).count();
+  double ops = (double) npairs * niterations * batchSize;
+
+  cout << "Time elapsed = " << elapsed << endl;
+  cout << "Cross-thread frees per second = " << ops / elapsed << endl;
+
+  return 0;
+}
@@ -0,0 +1,123 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  medium-objects.cpp
+ * @brief Measures churn of buffers from tens of KB to a few MB.
+ *
+ * Each thread keeps a window of live buffers of random sizes between
+ * the given bounds; every iteration frees the oldest one and allocates
+ * a replacement, writing its first and last bytes (like a service that
+ * fills a header and only part of the payload). Reports the time,
+ * the throughput, and the peak resident set size.
+ *
+ *  medium-objects <threads> <iterations> <min-size> <max-size> [<live>]
+ *
+ *  medium-objects 4 200000 65536 4194304 16
+ */
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+static long niterations = 200000;
+static size_t minSize = 65536;
+static size_t maxSize = 4 * 1048576;
+static int nlive = 16;
+
+static void worker (int id)
+{
+  unsigned long x = 88172645463325252UL + id;
+  vector<char *> live (nlive, nullptr);
+  for (long i = 0; i < niterations; i++) {
+    // xorshift
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    auto sz = minSize + x % (maxSize - minSize + 1);
+    auto& slot = live[i % nlive];
+    free (slot);
+    slot = (char *) malloc (sz);
+    slot[0] = (char) i;
+    slot[sz - 1] = (char) i;
+  }
+  for (auto * p : live) {
+    free (p);
+  }
+}
+
+int main (int argc, char * argv[])
+{
+  int nthreads = 4;
+
+  if (argc >= 2) {
+    nthreads = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    niterations = atol(argv[2]);
+  }
+  if (argc >= 4) {
+    minSize = atol(argv[3]);
+  }
+  if (argc >= 5) {
+    maxSize = atol(argv[4]);
+  }
+  if (argc >= 6) {
+    nlive = atoi(argv[5]);
+  }
+  if ((minSize == 0) || (maxSize < minSize) || (nlive < 1)) {
+    fprintf (stderr, "medium-objects: bad parameters.\n");
+    return 1;
+  }
+
+  printf ("Running medium-objects with %d threads, %ld iterations, %zu-%zu bytes, %d live...\n",
+	  nthreads, niterations, minSize, maxSize, nlive);
+
+  auto start = steady_clock::now();
+  vector<thread> threads;
+  for (int i = 0; i < nthreads; i++) {
+    threads.emplace_back (worker, i);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  cout << "Time elapsed = " << elapsed << " seconds." << endl;
+  cout << "Throughput = " << (double) nthreads * niterations / elapsed << " malloc/free pairs per second." << endl;
+#if !defined(_WIN32)
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  // ru_maxrss is in bytes on Mac OS X and in kilobytes elsewhere.
+#if defined(__APPLE__)
+  cout << "Peak RSS = " << usage.ru_maxrss / 1024 << " KB." << endl;
+#else
+  cout << "Peak RSS = " << usage.ru_maxrss << " KB." << endl;
+#endif
+#endif
+
+  return 0;
+}
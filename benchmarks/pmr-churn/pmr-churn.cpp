@@ -0,0 +1,152 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  pmr-churn.cpp
+ * @brief Measures container churn through hoard::memory_resource and
+ *        hoard::allocator.
+ *
+ * Each round fills a std::pmr::unordered_map with random keys and
+ * erases them again, then builds std::pmr::vectors of random lengths
+ * one push_back at a time. Runs with new_delete_resource(), with
+ * hoard::memory_resource over the thread's heap, and over a private
+ * heap destroyed after every round; then with std::allocator and
+ * hoard::allocator in the non-pmr containers. Since the program is
+ * linked with Hoard, new and delete use Hoard too: the differences are
+ * in the paths to it.
+ *
+ *  pmr-churn <rounds> <keys> <vectors>
+ *
+ *  pmr-churn 200 10000 2000
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hoardallocator.h"
+
+using namespace std;
+using namespace std::chrono;
+
+int nrounds = 200;
+int nkeys = 10000;
+int nvectors = 2000;
+
+// The work of one round, with maps and vectors that use the given allocators.
+template <class Map, class Vector>
+size_t round (typename Map::allocator_type mapAlloc, typename Vector::allocator_type vectorAlloc, mt19937& rng)
+{
+  size_t check = 0;
+  {
+    Map m (mapAlloc);
+    for (int i = 0; i < nkeys; i++) {
+      m[(int) rng()] = i;
+    }
+    check += m.size();
+    for (auto it = m.begin(); it != m.end(); ) {
+      it = m.erase (it);
+    }
+  }
+  for (int i = 0; i < nvectors; i++) {
+    Vector v (vectorAlloc);
+    int n = rng() % 1000;
+    for (int j = 0; j < n; j++) {
+      v.push_back (j);
+    }
+    check += v.size();
+  }
+  return check;
+}
+
+template <class Map, class Vector>
+double run (typename Map::allocator_type mapAlloc, typename Vector::allocator_type vectorAlloc)
+{
+  mt19937 rng (1);
+  size_t check = 0;
+  auto start = steady_clock::now();
+  for (int r = 0; r < nrounds; r++) {
+    check += round<Map, Vector> (mapAlloc, vectorAlloc, rng);
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  if (check == 0) {
+    abort();
+  }
+  return elapsed;
+}
+
+typedef pmr::unordered_map<int, int> PmrMap;
+typedef pmr::vector<int> PmrVector;
+
+double runResource (pmr::memory_resource * resource)
+{
+  return run<PmrMap, PmrVector> (resource, resource);
+}
+
+double runPrivateHeaps()
+{
+  mt19937 rng (1);
+  size_t check = 0;
+  auto start = steady_clock::now();
+  for (int r = 0; r < nrounds; r++) {
+    auto * heap = hoard_heap_create();
+    hoard::memory_resource resource (heap);
+    check += round<PmrMap, PmrVector> (&resource, &resource, rng);
+    hoard_heap_destroy (heap);
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  if (check == 0) {
+    abort();
+  }
+  return elapsed;
+}
+
+int main (int argc, char * argv[])
+{
+  if (argc >= 2) {
+    nrounds = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    nkeys = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    nvectors = atoi(argv[3]);
+  }
+
+  printf ("Running pmr-churn for %d rounds of %d keys and %d vectors...\n",
+	  nrounds, nkeys, nvectors);
+
+  hoard::memory_resource threadResource;
+
+  // Warm up, so that superblocks are already in place.
+  runResource (pmr::new_delete_resource());
+
+  cout << "new_delete_resource:            " << runResource (pmr::new_delete_resource()) << " seconds" << endl;
+  cout << "hoard::memory_resource:         " << runResource (&threadResource) << " seconds" << endl;
+  cout << "hoard::memory_resource, private: " << runPrivateHeaps() << " seconds" << endl;
+  cout << "std::allocator:                 "
+       << run<unordered_map<int, int>, vector<int>> ({}, {}) << " seconds" << endl;
+  cout << "hoard::allocator:               "
+       << run<unordered_map<int, int, hash<int>, equal_to<int>, hoard::allocator<pair<const int, int>>>,
+	      vector<int, hoard::allocator<int>>> ({}, {}) << " seconds" << endl;
+
+  return 0;
+}
@@ -0,0 +1,133 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  private-heap.cpp
+ * @brief Compares freeing a request's objects one at a time with
+ *        destroying a private heap that holds them.
+ *
+ * Each "request" allocates a number of objects of random small sizes
+ * and touches them, then releases them all: first with malloc and one
+ * free per object, then from a private heap released by
+ * hoard_heap_destroy (looked up at run time, so the benchmark runs
+ * under any allocator; without Hoard, only malloc is timed).
+ *
+ *  private-heap <requests> <objects-per-request> <max-size>
+ *
+ *  private-heap 2000 10000 256
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace std::chrono;
+
+int nrequests = 2000;
+int nobjects = 10000;
+int maxSize = 256;
+
+typedef void * (* heapCreateFunction) (void);
+typedef void * (* heapAllocFunction) (void *, size_t);
+typedef void (* heapDestroyFunction) (void *);
+
+heapCreateFunction heapCreate;
+heapAllocFunction heapAlloc;
+heapDestroyFunction heapDestroy;
+
+// Sets allocTime and releaseTime to the seconds spent in each.
+void run (bool private_, double& allocTime, double& releaseTime)
+{
+  vector<void *> objs (nobjects);
+  vector<size_t> sizes (nobjects);
+  mt19937 rng (1);
+  for (auto& sz : sizes) {
+    sz = 1 + rng() % maxSize;
+  }
+  allocTime = 0;
+  releaseTime = 0;
+  for (int i = 0; i < nrequests; i++) {
+    auto start = steady_clock::now();
+    void * heap = nullptr;
+    if (private_) {
+      heap = heapCreate();
+      for (int j = 0; j < nobjects; j++) {
+	objs[j] = heapAlloc (heap, sizes[j]);
+      }
+    } else {
+      for (int j = 0; j < nobjects; j++) {
+	objs[j] = malloc (sizes[j]);
+      }
+    }
+    auto middle = steady_clock::now();
+    for (int j = 0; j < nobjects; j++) {
+      *((char *) objs[j]) = (char) j;
+    }
+    auto touched = steady_clock::now();
+    if (private_) {
+      heapDestroy (heap);
+    } else {
+      for (int j = 0; j < nobjects; j++) {
+	free (objs[j]);
+      }
+    }
+    auto end = steady_clock::now();
+    allocTime += duration_cast<duration<double>>(middle - start).count();
+    releaseTime += duration_cast<duration<double>>(end - touched).count();
+  }
+}
+
+int main (int argc, char * argv[])
+{
+  if (argc >= 2) {
+    nrequests = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    nobjects = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    maxSize = atoi(argv[3]);
+  }
+
+  heapCreate = (heapCreateFunction) dlsym (RTLD_DEFAULT, "hoard_heap_create");
+  heapAlloc = (heapAllocFunction) dlsym (RTLD_DEFAULT, "hoard_heap_alloc");
+  heapDestroy = (heapDestroyFunction) dlsym (RTLD_DEFAULT, "hoard_heap_destroy");
+
+  printf ("Running private-heap for %d requests of %d objects (1-%d bytes)...\n",
+	  nrequests, nobjects, maxSize);
+
+  const double objects = (double) nrequests * nobjects;
+  double allocTime, releaseTime;
+  // Warm up, so that superblocks are already in place.
+  run (false, allocTime, releaseTime);
+  run (false, allocTime, releaseTime);
+  cout << "malloc and free:       "
+       << allocTime * 1e9 / objects << " ns per malloc, "
+       << releaseTime * 1e9 / objects << " ns per object released" << endl;
+  if (heapCreate && heapAlloc && heapDestroy) {
+    run (true, allocTime, releaseTime);
+    cout << "private heap, destroy: "
+	 << allocTime * 1e9 / objects << " ns per alloc, "
+	 << releaseTime * 1e9 / objects << " ns per object released" << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,87 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  sizeclass-free.cpp
+ * @brief Measures single-threaded free throughput for given object sizes.
+ *
+ * For each size, repeatedly allocates a batch of objects (untimed) and
+ * then frees them (timed). Every free has to find the start of its
+ * object, so sizes that are not powers of two (the default 48, 80 and
+ * 112) show the cost of that computation; add 64 for comparison.
+ *
+ *  sizeclass-free <iterations> <batch> [<object-size> ...]
+ *
+ *  sizeclass-free 2000 1000 48 64 80 112
+ */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace std::chrono;
+
+int niterations = 2000;
+int batchSize = 1000;
+
+double freesPerSecond (size_t objSize)
+{
+  vector<char *> objs (batchSize);
+  double elapsed = 0;
+  for (int i = 0; i < niterations; i++) {
+    for (int j = 0; j < batchSize; j++) {
+      objs[j] = (char *) malloc (objSize);
+      objs[j][0] = (char) j;
+    }
+    auto start = steady_clock::now();
+    for (int j = 0; j < batchSize; j++) {
+      free (objs[j]);
+    }
+    elapsed += duration_cast<duration<double>>(steady_clock::now() - start).count();
+  }
+  return (double) niterations * batchSize / elapsed;
+}
+
+int main (int argc, char * argv[])
+{
+  if (argc >= 2) {
+    niterations = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    batchSize = atoi(argv[2]);
+  }
+  vector<size_t> sizes;
+  for (int i = 3; i < argc; i++) {
+    sizes.push_back (atoi(argv[i]));
+  }
+  if (sizes.empty()) {
+    sizes = { 48, 80, 112 };
+  }
+
+  printf ("Running sizeclass-free for %d iterations, batch %d...\n",
+	  niterations, batchSize);
+
+  for (auto sz : sizes) {
+    // Warm up, so that superblocks are already in place.
+    freesPerSecond (sz);
+    cout << "Object size " << sz << ": frees per second = " << freesPerSecond (sz) << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  superblock-sets.cpp
+ * @brief Measures cache-set conflicts among objects and headers of many superblocks.
+ *
+ * Allocates until it has found the first object of each of <superblocks>
+ * distinct superblocks, then times two loops over those objects: one
+ * that just touches each object, and one that asks the allocator for
+ * each object's size (which reads the superblock header). If
+ * superblock-aligned headers or first objects all land in the same
+ * cache sets, these working sets thrash long before they outgrow the
+ * cache.
+ *
+ *  superblock-sets <superblocks> <rounds> <object-size> <superblock-size>
+ *
+ *  superblock-sets 64 100000 64 262144
+ */
+
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace std::chrono;
+
+int main (int argc, char * argv[])
+{
+  int nsuperblocks = 64;
+  int nrounds = 100000;
+  size_t objSize = 64;
+  size_t superblockSize = 262144;
+
+  if (argc >= 2) {
+    nsuperblocks = atoi(argv[1]);
+  }
+  if (argc >= 3) {
+    nrounds = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    objSize = atoi(argv[3]);
+  }
+  if (argc >= 5) {
+    superblockSize = atol(argv[4]);
+  }
+
+  printf ("Running superblock-sets for %d superblocks, %d rounds, object size %zu, superblock size %zu...\n",
+	  nsuperblocks, nrounds, objSize, superblockSize);
+
+  // Find the lowest-addressed object we get from each superblock. We
+  // never free anything, so the superblocks stay put.
+  vector<char *> first;
+  unordered_map<size_t, size_t> seen;
+  size_t allocated = 0;
+  while ((int) first.size() < nsuperblocks) {
+    auto * p = (char *) malloc (objSize);
+    allocated++;
+    auto sb = (size_t) p & ~(superblockSize - 1);
+    auto it = seen.find (sb);
+    if (it == seen.end()) {
+      seen[sb] = first.size();
+      first.push_back (p);
+    } else if (p < first[it->second]) {
+      first[it->second] = p;
+    }
+  }
+
+  // Report how many distinct cache-line offsets (mod 4K, i.e., L1 sets) the first objects use.
+  vector<bool> sets (4096 / 64);
+  int distinctSets = 0;
+  for (auto * p : first) {
+    auto set = ((size_t) p % 4096) / 64;
+    if (!sets[set]) {
+      sets[set] = true;
+      distinctSets++;
+    }
+  }
+
+  high_resolution_clock t;
+  const double accesses = (double) nrounds * nsuperblocks;
+
+  // Objects only.
+  auto start = t.now();
+  for (int r = 0; r < nrounds; r++) {
+    for (auto * p : first) {
+      p[0]++;
+    }
+  }
+  auto objectTime = duration_cast<duration<double>>(t.now() - start).count();
+
+  // Headers (via the allocator's size lookup).
+  size_t sum = 0;
+  start = t.now();
+  for (int r = 0; r < nrounds; r++) {
+    for (auto * p : first) {
+      sum += malloc_usable_size (p);
+    }
+  }
+  auto headerTime = duration_cast<duration<double>>(t.now() - start).count();
+
+  cout << "Objects allocated = " << allocated << endl;
+  cout << "Distinct L1 sets used by first objects = " << distinctSets << endl;
+  cout << "ns per object touch = " << objectTime * 1e9 / accesses << endl;
+  cout << "ns per header lookup = " << headerTime * 1e9 / accesses << endl;
+  return (sum == 0);
+}
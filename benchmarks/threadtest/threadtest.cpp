@@ -40,6 +40,7 @@ using namespace std::chrono;
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 
@@ -115,6 +116,14 @@ int main (int argc, char * argv[])
   
   if (argc >= 2) {
     nthreads = atoi(argv[1]);
+    // Oversubscription mode: "threadtest 4x ..." runs four threads per
+    // hardware thread, so that threads are routinely preempted while
+    // holding allocator locks.
+    auto len = strlen(argv[1]);
+    if ((len > 1) && (argv[1][len - 1] == 'x')) {
+      auto ncpus = (int) thread::hardware_concurrency();
+      nthreads *= (ncpus > 0) ? ncpus : 1;
+    }
   }
 
   if (argc >= 3) {
@@ -0,0 +1,111 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * @file  tiny-objects.cpp
+ * @brief Measures footprint and speed for many pointer-sized objects.
+ *
+ * Builds a linked list of the given number of objects, each just big
+ * enough for its link (like graph nodes or boxed integers), walks it,
+ * and frees it, for the given number of rounds. Reports the time and
+ * the peak resident set size.
+ *
+ *  tiny-objects <objects> <rounds> [<object-size>]
+ *
+ *  tiny-objects 10000000 5 8
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+struct Node {
+  Node * next;
+};
+
+int main (int argc, char * argv[])
+{
+  long nobjects = 10000000;
+  int nrounds = 5;
+  size_t objSize = sizeof(Node);
+
+  if (argc >= 2) {
+    nobjects = atol(argv[1]);
+  }
+  if (argc >= 3) {
+    nrounds = atoi(argv[2]);
+  }
+  if (argc >= 4) {
+    objSize = atoi(argv[3]);
+  }
+  if (objSize < sizeof(Node)) {
+    objSize = sizeof(Node);
+  }
+
+  printf ("Running tiny-objects with %ld objects of %zu bytes, %d rounds...\n",
+	  nobjects, objSize, nrounds);
+
+  long misaligned = 0;
+  auto start = steady_clock::now();
+  for (int r = 0; r < nrounds; r++) {
+    Node * head = nullptr;
+    for (long i = 0; i < nobjects; i++) {
+      auto * n = (Node *) malloc (objSize);
+      misaligned += ((size_t) n % sizeof(Node)) != 0;
+      n->next = head;
+      head = n;
+    }
+    long length = 0;
+    for (auto * n = head; n; n = n->next) {
+      length++;
+    }
+    if (length != nobjects) {
+      fprintf (stderr, "tiny-objects: list is broken.\n");
+      return 1;
+    }
+    while (head) {
+      auto * next = head->next;
+      free (head);
+      head = next;
+    }
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  cout << "Time elapsed = " << elapsed << " seconds." << endl;
+#if !defined(_WIN32)
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  // ru_maxrss is in bytes on Mac OS X and in kilobytes elsewhere.
+#if defined(__APPLE__)
+  cout << "Peak RSS = " << usage.ru_maxrss / 1024 << " KB." << endl;
+#else
+  cout << "Peak RSS = " << usage.ru_maxrss << " KB." << endl;
+#endif
+#endif
+  if (misaligned) {
+    cout << misaligned << " objects were not pointer-aligned." << endl;
+  }
+
+  return 0;
+}
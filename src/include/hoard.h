@@ -0,0 +1,186 @@
+/* -*- C -*- */
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/*
+ * @file   hoard.h
+ * @brief  Hoard-specific extensions to the standard allocation API.
+ */
+
+#ifndef HOARD_H
+#define HOARD_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define HOARD_API __declspec(dllexport)
+#else
+#define HOARD_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Lock contention profiling. Only available when Hoard is built with
+ * -DHOARD_LOCK_PROFILING=1; otherwise these report no sites.
+ */
+
+/* Number of wait-time histogram buckets; bucket i counts waits of
+   [2^i, 2^(i+1)) nanoseconds (the last bucket also counts longer ones). */
+#define HOARD_LOCK_WAIT_BUCKETS 24
+
+typedef struct hoard_lock_stats {
+  const char * site;                 /* Which layer of the heap the locks belong to. */
+  unsigned long long acquisitions;   /* Total lock acquisitions. */
+  unsigned long long contended;      /* Acquisitions that found the lock held. */
+  unsigned long long spins;          /* Spin iterations of contended acquirers, for
+                                        locks that count them (else 0). */
+  unsigned long long wait_ns;        /* Total time spent waiting, in nanoseconds. */
+  unsigned long long wait_histogram[HOARD_LOCK_WAIT_BUCKETS];
+} hoard_lock_stats;
+
+/* Fill in up to count entries, one per lock site; returns the number of sites. */
+HOARD_API int hoard_lock_stats_get (hoard_lock_stats * stats, int count);
+
+/* Zero all lock statistics. */
+HOARD_API void hoard_lock_stats_reset (void);
+
+/* Print lock statistics to stderr. */
+HOARD_API void hoard_lock_stats_print (void);
+
+/* Turn recording on (1) or off (0); returns the previous setting, or -1
+   if profiling is not compiled in. */
+HOARD_API int hoard_lock_profiling (int enable);
+
+/*
+ * realloc growth. When realloc keeps growing the same object, Hoard
+ * asks for half again as much as requested, so that the object can
+ * grow in place for a while; these counters show how often that
+ * happens and what it costs. They cover every thread.
+ */
+
+typedef struct hoard_realloc_stats {
+  unsigned long long grown;          /* reallocs that outgrew their object and copied it. */
+  unsigned long long resized;        /* reallocs that grew a big object without copying. */
+  unsigned long long promoted;       /* Of the copies, objects given room to grow. */
+  unsigned long long headroom_bytes; /* The extra bytes asked for, in all. */
+} hoard_realloc_stats;
+
+/* Fill in the realloc growth counters. */
+HOARD_API void hoard_realloc_stats_get (hoard_realloc_stats * stats);
+
+/* Zero the realloc growth counters. */
+HOARD_API void hoard_realloc_stats_reset (void);
+
+/*
+ * Size-returning allocation. Objects come in size classes, so a request
+ * usually gets more room than it asked for; callers that grow buffers
+ * can use all of it.
+ */
+
+typedef struct hoard_sized_ptr {
+  void * p;                          /* The object. */
+  size_t n;                          /* Its usable size, at least as requested. */
+} hoard_sized_ptr;
+
+/* The usable size of the object that malloc (sz) would return. Requests
+   above 64KB may get a larger object than this, never a smaller one. */
+HOARD_API size_t hoard_good_size (size_t sz);
+
+/* Like malloc, but also returns the object's usable size. */
+HOARD_API hoard_sized_ptr hoard_malloc_sized (size_t sz);
+
+/* The same, in the shape proposed for C++ by P0901. */
+typedef hoard_sized_ptr __sized_ptr_t;
+HOARD_API __sized_ptr_t __size_returning_new (size_t sz);
+
+/*
+ * Batch allocation, for programs that allocate and free many objects
+ * of one size at once. Small objects come from the thread's cache and
+ * then straight from superblocks, with one lock per superblock's worth.
+ */
+
+/* Put n objects of sz bytes each into ptrs; returns how many (fewer
+   than n only if memory runs out). */
+HOARD_API size_t hoard_malloc_batch (size_t sz, size_t n, void ** ptrs);
+
+/* Free the n objects in ptrs (null entries are skipped). Objects are
+   cheapest to free in the order hoard_malloc_batch returned them. */
+HOARD_API void hoard_free_batch (void ** ptrs, size_t n);
+
+/*
+ * Allocation with flags, in the style of jemalloc's mallocx. Flags are
+ * an alignment ORed with any of the options below; 0 means plain
+ * malloc (or realloc, or free).
+ */
+
+#define HOARD_ALLOCX_LG_ALIGN(la) ((int) (la))  /* Align to 2^la bytes. */
+#define HOARD_ALLOCX_LG_ALIGN_MASK 0x3f
+#define HOARD_ALLOCX_ZERO 0x40                   /* Zero new bytes. */
+#define HOARD_ALLOCX_NO_CACHE 0x80               /* Bypass this thread's caches. */
+
+/* Allocate sz bytes as flags say; returns null if memory runs out. */
+HOARD_API void * hoard_allocx (size_t sz, int flags);
+
+/* Resize ptr to sz bytes, in place if it fits (or can grow) and is
+   aligned as flags say, else by moving it. With HOARD_ALLOCX_ZERO, the
+   bytes past the old usable size are zero. Returns null if memory runs
+   out, leaving ptr alone. */
+HOARD_API void * hoard_reallocx (void * ptr, size_t sz, int flags);
+
+/* Grow ptr to at least sz bytes without moving it: objects already big
+   enough, or big objects whose mappings can be extended. Returns the
+   new usable size, or 0 (leaving ptr alone) if it cannot. */
+HOARD_API size_t hoard_expand (void * ptr, size_t sz);
+
+/* Free ptr as flags say. */
+HOARD_API void hoard_dallocx (void * ptr, int flags);
+
+/* Free ptr, which hoard_allocx (sz, flags) returned. Knowing the size
+   spares small objects a look at their superblock, as with sized
+   delete; it must be the size ptr was allocated with (not resized). */
+HOARD_API void hoard_sdallocx (void * ptr, size_t sz, int flags);
+
+/*
+ * Private heaps, for objects that die together (say, everything a
+ * request allocates). Destroying a heap frees all of its objects at
+ * once, in time proportional to its superblocks rather than its
+ * objects. Objects can also be freed one at a time, with
+ * hoard_heap_free, plain free or sized delete. One thread at
+ * a time may allocate from a heap; any thread may free to it. Objects
+ * must be no larger than 64KB or so (see hoard_heap_alloc).
+ */
+
+typedef struct hoard_heap hoard_heap;
+
+/* Make a new, empty heap; returns null if memory runs out. */
+HOARD_API hoard_heap * hoard_heap_create (void);
+
+/* Allocate sz bytes from heap; returns null if memory runs out or sz
+   is too large for a superblock. */
+HOARD_API void * hoard_heap_alloc (hoard_heap * heap, size_t sz);
+
+/* Free ptr, which came from heap (or from malloc, which free handles). */
+HOARD_API void hoard_heap_free (hoard_heap * heap, void * ptr);
+
+/* Free every object in heap, and the heap itself. */
+HOARD_API void hoard_heap_destroy (hoard_heap * heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,7 +22,10 @@
  *
  */
 
+#include <atomic>
+
 #include "heaplayers.h"
+#include "threadtoken.h"
 
 namespace Hoard {
 
@@ -46,18 +49,24 @@ namespace Hoard {
     /// @brief Check if current thread owns this heap (for same-thread optimization).
     /// @return true if current thread is the owner, false otherwise.
     inline bool isCurrentThreadOwner() const {
-      return _ownerThreadId == HL::CPUInfo::getThreadId();
+      return getOwnerThreadId() == currentThreadToken();
+    }
+
+    /// @brief Set the owning thread for this heap (0 = no exclusive owner).
+    /// @param tid Token of the owner (see currentThreadToken).
+    inline void setOwnerThreadId(ThreadToken tid) {
+      _ownerThreadId.store(tid, std::memory_order_release);
     }
 
-    /// @brief Set the owning thread ID for this heap.
-    /// @param tid Thread ID of the owner.
-    inline void setOwnerThreadId(unsigned int tid) {
-      _ownerThreadId = tid;
+    /// @brief Get the owning thread's token (0 if the heap is shared).
+    inline ThreadToken getOwnerThreadId() const {
+      return _ownerThreadId.load(std::memory_order_acquire);
     }
 
-    /// @brief Get the owning thread ID.
-    inline unsigned int getOwnerThreadId() const {
-      return _ownerThreadId;
+    /// @brief True iff exactly one thread owns this heap, in which case
+    ///        that thread may operate on it without locks.
+    inline bool isExclusive() const {
+      return getOwnerThreadId() != 0;
     }
 
     // Export the superblock type.
@@ -92,8 +101,9 @@ namespace Hoard {
 
     const unsigned long _magic;
 
-    /// Thread ID of the owning thread (for same-thread detection in RedirectFree).
-    unsigned int _ownerThreadId;
+    /// Token of the exclusive owner, or 0 if the heap is shared.
+    /// Set by HeapManager when a heap is handed to a single thread.
+    std::atomic<ThreadToken> _ownerThreadId;
 
     /// Whether this heap is currently active (owned by a live thread).
     /// Used for superblock reclaim optimization on cross-thread frees.
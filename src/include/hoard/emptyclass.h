@@ -21,6 +21,7 @@
 #include "check.h"
 #include "array.h"
 #include "heaplayers.h"
+#include "hoardconstants.h"
 
 /**
  * @class EmptyClass
@@ -30,7 +31,8 @@
 namespace Hoard {
 
   template <class SuperblockType_,
-	    int EmptinessClasses>
+	    int EmptinessClasses,
+	    class LockType = HL::SpinLock>
   class EmptyClass {
 
     enum { SuperblockSize = sizeof(SuperblockType_) };
@@ -76,6 +78,24 @@ namespace Hoard {
       return 0;
     }
 
+    /// Remove any superblock, full ones included; null if there are none.
+    SuperblockType * getAny() {
+      Check<EmptyClass, MyChecker> check (this);
+      for (auto n = 0; n <= EmptinessClasses + 1; n++) {
+	auto * s = _available(n);
+	if (s) {
+	  _available(n) = s->getNext();
+	  if (_available(n)) {
+	    _available(n)->setPrev (0);
+	  }
+	  s->setPrev (0);
+	  s->setNext (0);
+	  return s;
+	}
+      }
+      return 0;
+    }
+
     SuperblockType * get() {
       Check<EmptyClass, MyChecker> check (this);
       // Return as empty a superblock as possible
@@ -160,7 +180,7 @@ namespace Hoard {
 	    if (oldCl != newCl) {
 	      transfer (s, oldCl, newCl);
 	    }
-	    assert ((size_t) ptr % SuperblockType::Alignment == 0);
+	    assert ((size_t) ptr % MinObjectAlignment == 0);
 	    return ptr;
 	  }
 	}
@@ -193,12 +213,16 @@ namespace Hoard {
      *
      * Called during malloc to process cross-thread frees pushed to
      * superblocks via pushDelayedFree(). Iterates through emptiness
-     * classes and drains any pending delayed frees.
+     * classes and drains any pending delayed frees. This visits every
+     * superblock in the bin, so malloc only calls it when the bin has
+     * no room left.
      */
-    inline unsigned int drainDelayedFrees(unsigned int* inUseCount) {
+    inline unsigned int drainDelayedFrees(uint64_t* inUseCount) {
       unsigned int totalFreed = 0;
-      // Iterate from fullest to emptiest (matching malloc order)
-      for (int i = EmptinessClasses; i >= 0; i--) {
+      // Iterate from fullest to emptiest (matching malloc order).
+      // Start with the full class: those superblocks can only
+      // regain space through delayed frees.
+      for (int i = EmptinessClasses + 1; i >= 0; i--) {
         SuperblockType * s = _available(i);
         while (s) {
           // Save next pointer before potential transfer
@@ -331,7 +355,7 @@ namespace Hoard {
     }
 
     /// Per-bin lock for thread-safe list operations.
-    HL::SpinLock _listLock;
+    LockType _listLock;
 
     /// The bins of superblocks, by emptiness class.
     /// @note index 0 = completely empty, EmptinessClasses + 1 = full
@@ -348,13 +372,13 @@ namespace Hoard {
 
     /// Thread-safe put (acquires lock internally).
     void putLocked(SuperblockType* s) {
-      std::lock_guard<HL::SpinLock> l(_listLock);
+      std::lock_guard<LockType> l(_listLock);
       put(s);
     }
 
     /// Thread-safe get (acquires lock internally).
     SuperblockType* getLocked() {
-      std::lock_guard<HL::SpinLock> l(_listLock);
+      std::lock_guard<LockType> l(_listLock);
       return get();
     }
 
@@ -16,7 +16,6 @@
 #ifndef HOARD_GEOMETRIC_SIZECLASS_H
 #define HOARD_GEOMETRIC_SIZECLASS_H
 
-#include <cmath>
 #include <cstdlib>
 #include <cassert>
 
@@ -52,6 +51,31 @@ namespace Hoard {
 	   (Value * BaseDenominator) / BaseNumerator>::VALUE };
   };
 
+  /// The size of each geometric size class, computed at compile time.
+  template <size_t MaxOverhead, size_t Alignment, int NumClasses>
+  struct GeometricSizeTable {
+
+    size_t sizes[NumClasses];
+
+    constexpr GeometricSizeTable()
+      : sizes()
+    {
+      const double base =
+	(1.0 + (double) MaxOverhead / (double) 100.0);
+      size_t sz = Alignment;
+      for (int i = 0; i < NumClasses; i++) {
+	sizes[i] = sz;
+	// (Truncation is floor, since everything is positive.)
+	size_t newSz = (size_t) ((double) base * (double) sz);
+	newSz = newSz - (newSz % Alignment);
+	while ((double) newSz / (double) sz < base) {
+	  newSz += Alignment;
+	}
+	sz = newSz;
+      }
+    }
+  };
+
   /// @class GeometricSizeClass
   /// @brief Manages geometrically-increasing size classes.
 
@@ -96,61 +120,50 @@ namespace Hoard {
     enum { MaxObjectSize = (1UL << 25) };
 #endif
 
-  private:
-
-    /// Verify that this class is working properly.
+    /// Verify that this class is working properly. Since size2class
+    /// is monotonic, it is enough to check that each class size maps
+    /// to its own class and the next size up to the next class; this
+    /// keeps the check cheap enough to run at compile time (see below).
     static bool constexpr test() {
-      // Iterate just up to 1MB for now.
-      for (size_t sz = Alignment; sz < 1048576; sz += Alignment) {
-	int cl = size2class (sz);
-	if (sz > class2size(cl)) {
-	  assert (sz <= class2size(cl));
-	  return false;
-	}
-      }
       for (int cl = 0; cl < NUM_SIZECLASSES; cl++) {
 	size_t sz = class2size (cl);
-	if (cl != size2class(sz)) {
-	  assert (cl == size2class(sz));
+	if ((sz % Alignment != 0) || (cl != size2class(sz))) {
+	  return false;
+	}
+	if ((cl + 1 < NUM_SIZECLASSES) && (size2class(sz + 1) != cl + 1)) {
 	  return false;
 	}
       }
       return true;
     }
 
+  private:
+
     /// The total number of size classes.
     enum { NUM_SIZECLASSES = ilog<100+MaxOverhead,
 	   100,
 	   MaxObjectSize>::VALUE };
 
-    /// Quickly compute the maximum size for a given size class.
-    static unsigned long c2s (int cl) {
-      static size_t sizes[NUM_SIZECLASSES];
-      static bool init = createTable ((size_t *) sizes);
-      init = init;
-      return sizes[cl];
-    }
+    /// The class sizes (no initialization check needed).
+    static constexpr GeometricSizeTable<MaxOverhead, Alignment, NUM_SIZECLASSES> theSizes {};
 
-    /// Builds an array to speed size computations, stored in sizes.
-    static bool createTable (size_t * sizes)
-    {
-      const double base =
-	(1.0 + (double) MaxOverhead / (double) 100.0);
-      size_t sz = Alignment;
-      for (int i = 0; i < NUM_SIZECLASSES; i++) {
-	sizes[i] = sz;
-	size_t newSz = (size_t) (floor ((double) base * (double) sz));
-	newSz = newSz - (HL::Modulo<Alignment>::mod (newSz));
-	while ((double) newSz / (double) sz < base) {
-	  newSz += Alignment;
-	}
-	sz = newSz;
-      }
-      return true;
+    /// Quickly compute the maximum size for a given size class.
+    static constexpr size_t c2s (int cl) {
+      return theSizes.sizes[cl];
     }
 
   };
 
+  // Lookups index the table at run time, which needs a definition
+  // before C++17 (where constexpr static members became inline).
+  template <size_t MaxOverhead, size_t Alignment>
+  constexpr GeometricSizeTable<MaxOverhead, Alignment, GeometricSizeClass<MaxOverhead, Alignment>::NUM_SIZECLASSES>
+  GeometricSizeClass<MaxOverhead, Alignment>::theSizes;
+
+  // The big-object heap uses these classes (see hoardheap.h).
+  static_assert(GeometricSizeClass<20>::test(),
+		"Geometric size classes are inconsistent.");
+
 }
 
 #if defined(__clang__)
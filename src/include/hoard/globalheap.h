@@ -27,12 +27,14 @@ namespace Hoard {
 		      typename HeapType_> class Header_,
 	    int EmptinessClasses,
 	    class MmapSource,
-	    class LockType>
+	    class LockType,
+	    class HeapLockType = LockType,
+	    class BinLockType = HeapLockType>
   class GlobalHeap {
   
     class bogusThresholdFunctionClass {
     public:
-      static inline bool function (unsigned int, unsigned int, size_t) {
+      static inline bool function (uint64_t, uint64_t, size_t) {
 	// We *never* cross the threshold for the global heap, since
 	// it is the "top."
 	return false;
@@ -46,7 +48,7 @@ namespace Hoard {
     {
     }
   
-    typedef ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, bogusThresholdFunctionClass, MmapSource> SuperHeap;
+    typedef ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, bogusThresholdFunctionClass, MmapSource, HeapLockType, BinLockType> SuperHeap;
     typedef HoardSuperblock<LockType, SuperblockSize, GlobalHeap, Header_> SuperblockType;
   
     void put (void * s, size_t sz) {
@@ -66,6 +68,17 @@ namespace Hoard {
       return s;
     }
 
+    /// Like get, but only a completely empty superblock will do.
+    SuperblockType * getEmpty (size_t sz, void * dest) {
+      auto * s =
+	reinterpret_cast<SuperblockType *>
+	(_theHeap->getEmpty (sz, reinterpret_cast<SuperHeap *>(dest)));
+      if (s) {
+	assert (s->isValidSuperblock());
+      }
+      return s;
+    }
+
   private:
 
     SuperHeap * _theHeap;
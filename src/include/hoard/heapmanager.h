@@ -21,6 +21,7 @@
 
 #include "hoardconstants.h"
 #include "heaplayers.h"
+#include "threadtoken.h"
 
 namespace Hoard {
 
@@ -57,7 +58,15 @@ namespace Hoard {
       auto tid_original = HL::CPUInfo::getThreadId();
       auto tid = tid_original % HeapType::MaxThreads;
 
-      int i = 0;
+#if !HOARD_NO_EXCLUSIVE_HEAPS
+      // Heap 0 is shared by every thread that never comes through here
+      // (e.g., the main thread), so it can never be exclusive: hand out
+      // the others first.
+      const int firstHeap = 1;
+#else
+      const int firstHeap = 0;
+#endif
+      int i = firstHeap;
       while ((i < HeapType::MaxHeaps) && (HeapType::getInusemap(i)))
 	i++;
       if (i >= HeapType::MaxHeaps) {
@@ -67,12 +76,20 @@ namespace Hoard {
 #else
 	auto randomNumber = (int) lrand48();
 #endif
-	i = randomNumber % HeapType::MaxHeaps;
+	i = firstHeap + randomNumber % (HeapType::MaxHeaps - firstHeap);
       }
 
-      HeapType::setInusemap (i, 1);
+      auto users = HeapType::getInusemap (i) + 1;
+      HeapType::setInusemap (i, users);
       HeapType::setTidMap ((int) tid, i);
 
+#if !HOARD_NO_EXCLUSIVE_HEAPS
+      // A heap with exactly one user needs no locks on malloc.
+      if ((users == 1) && (i != 0)) {
+	HeapType::setHeapOwner (i, currentThreadToken());
+      }
+#endif
+
       // Mark the heap as active (for superblock reclaim optimization).
       HeapType::setHeapActive(i, true);
 
@@ -91,19 +108,26 @@ namespace Hoard {
       // Statically ensure that the number of threads is a power of two.
       enum { VerifyPowerOfTwo = 1 / ((HeapType::MaxThreads & ~(HeapType::MaxThreads-1))) };
 
-      auto tid = (int) (HL::CPUInfo::getThreadId() & (HeapType::MaxThreads - 1));
+      auto tid_original = HL::CPUInfo::getThreadId();
+      auto tid = (int) (tid_original & (HeapType::MaxThreads - 1));
       auto heapIndex = HeapType::getTidMap (tid);
 
-      HeapType::setInusemap (heapIndex, 0);
+      HeapType::setInusemap (heapIndex, HeapType::getInusemap (heapIndex) - 1);
 
-      // Mark the heap as inactive (for superblock reclaim optimization).
-      HeapType::setHeapActive(heapIndex, false);
+      // Drop exclusive ownership, if we held it.
+      HeapType::releaseHeapOwner (heapIndex, currentThreadToken());
 
       // Prevent underruns (defensive programming).
 
       if (HeapType::getInusemap (heapIndex) < 0) {
 	HeapType::setInusemap (heapIndex, 0);
       }
+
+      // Mark the heap as inactive once its last user is gone
+      // (for superblock reclaim optimization).
+      if (HeapType::getInusemap (heapIndex) == 0) {
+	HeapType::setHeapActive(heapIndex, false);
+      }
     }
     
     
@@ -0,0 +1,401 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_HOARDBITMAPSUPERBLOCKHEADER_H
+#define HOARD_HOARDBITMAPSUPERBLOCKHEADER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "heaplayers.h"
+#include "hoardconstants.h"
+#include "../util/atomicfreelist.h"
+#include "../util/reciprocal.h"
+
+namespace Hoard {
+
+  template <class LockType,
+	    int SuperblockSize,
+	    typename HeapType,
+	    template <class LockType_,
+		      int SuperblockSize_,
+		      typename HeapType_>
+	    class Header_>
+  class HoardSuperblock;
+
+  /**
+   * @class HoardBitmapSuperblockHeader
+   * @brief A superblock header that tracks free objects with a bitmap.
+   *
+   * A drop-in replacement for HoardSuperblockHeader (pass it as the
+   * Header_ argument of HoardSuperblock). Instead of an intrusive
+   * freelist, each object has one bit, set while the object is free.
+   * Allocation takes the lowest free object, found by scanning from
+   * the first word that may have one and counting trailing zeros, so
+   * objects are reused in address order rather than LIFO and
+   * allocation never loads through a freed object. The bitmap also
+   * catches double frees, which we drop.
+   */
+  template <class LockType,
+	    int SuperblockSize,
+	    typename HeapType>
+  class HoardBitmapSuperblockHeader {
+  public:
+
+    enum { Alignment = ObjectAlignment };
+
+    typedef HoardSuperblock<LockType, SuperblockSize, HeapType, HoardBitmapSuperblockHeader> BlockType;
+
+    /// @param colorOffset Bytes to skip before the first object (see HoardSuperblock::colorOffset).
+    /// @param buffer      Where the objects go; by default, right after this header.
+    HoardBitmapSuperblockHeader (size_t sz, size_t bufferSize, size_t colorOffset = 0, char * buffer = nullptr)
+      : _magicNumber (MAGIC_NUMBER ^ (size_t) this),
+	_objectSize (sz),
+	_objectSizeIsPowerOfTwo (!(sz & (sz - 1)) && sz),
+	_private (false),
+	_objectSizeShift (log2 (sz)),
+	_totalObjects ((unsigned int) ((bufferSize - colorOffset) / sz)),
+	_start ((buffer ? buffer : (char *) (this + 1)) + colorOffset),
+	_owner (nullptr),
+	_objectSizeReciprocal (sz),
+	_objectsFree (0),
+	_firstFreeWord (0),
+	_prev (nullptr),
+	_next (nullptr)
+    {
+      static_assert(sizeof(HoardBitmapSuperblockHeader) % Alignment == 0,
+		    "Superblock header size must be a multiple of the alignment.");
+      static_assert(BitmapWords % 2 == 0,
+		    "The bitmap is scanned two words at a time.");
+      assert ((HL::align<Alignment>((size_t) _start) == (size_t) _start));
+      assert (_objectSize >= MinObjectAlignment);
+      assert ((_totalObjects == 1) || (_objectSize % Alignment == 0) || (_objectSize == TinyObjectSize));
+      assert (_totalObjects <= MaxObjects);
+      clear();
+    }
+
+    inline void * malloc() {
+      assert (isValid());
+      if (_objectsFree == 0) {
+	return nullptr;
+      }
+      auto w = findFreeWord (_firstFreeWord);
+      auto bits = _freeBits[w];
+      auto bit = countTrailingZeros (bits);
+      _freeBits[w] = bits & (bits - 1);
+      _firstFreeWord = w;
+      _objectsFree--;
+      auto * ptr = _start + ((size_t) w * BitsPerWord + bit) * _objectSize;
+      assert ((size_t) ptr % MinObjectAlignment == 0);
+      return ptr;
+    }
+
+    inline void free (void * ptr) {
+      assert ((size_t) ptr % MinObjectAlignment == 0);
+      assert (isValid());
+      freeObject (ptr);
+    }
+
+    void clear() {
+      assert (isValid());
+      // Mark every object free. Words past the last object are never
+      // read, so we leave them alone.
+      auto fullWords = _totalObjects / BitsPerWord;
+      for (unsigned int i = 0; i < fullWords; i++) {
+	_freeBits[i] = ~(uint64_t) 0;
+      }
+      auto rest = _totalObjects % BitsPerWord;
+      if (rest) {
+	_freeBits[fullWords] = ((uint64_t) 1 << rest) - 1;
+      }
+      _objectsFree = _totalObjects;
+      _firstFreeWord = 0;
+    }
+
+    /// @brief Returns the actual start of the object.
+    INLINE void * normalize (void * ptr) const {
+      assert (isValid());
+      auto offset = (size_t) ptr - (size_t) _start;
+      void * p;
+      if (_objectSizeIsPowerOfTwo) {
+	p = (void *) ((size_t) ptr - (offset & (_objectSize - 1)));
+      } else {
+	p = (void *) ((size_t) ptr - _objectSizeReciprocal.remainder (offset));
+      }
+      return p;
+    }
+
+    size_t getSize (void * ptr) const {
+      assert (isValid());
+      auto offset = (size_t) ptr - (size_t) _start;
+      size_t newSize;
+      if (_objectSizeIsPowerOfTwo) {
+	newSize = _objectSize - (offset & (_objectSize - 1));
+      } else {
+	newSize = _objectSize - _objectSizeReciprocal.remainder (offset);
+      }
+      return newSize;
+    }
+
+    size_t getObjectSize() const {
+      return _objectSize;
+    }
+
+    /// The address of the first object.
+    const char * getStart() const {
+      return _start;
+    }
+
+    unsigned int getTotalObjects() const {
+      return _totalObjects;
+    }
+
+    unsigned int getObjectsFree() const {
+      return _objectsFree;
+    }
+
+    bool isPrivate() const {
+      return _private;
+    }
+
+    void setPrivate (bool p) {
+      _private = p;
+    }
+
+    /// Get current owner (atomic acquire for visibility).
+    HeapType* getOwner() const {
+      return _owner.load(std::memory_order_acquire);
+    }
+
+    /// Set owner (atomic release for visibility).
+    void setOwner(HeapType* o) {
+      _owner.store(o, std::memory_order_release);
+    }
+
+    /// Try to atomically claim ownership (for lock-free reclaim).
+    bool tryClaimOwnership(HeapType* expected, HeapType* newOwner) {
+      return _owner.compare_exchange_strong(
+        expected, newOwner,
+        std::memory_order_acq_rel,
+        std::memory_order_acquire);
+    }
+
+    bool isValid() const {
+      return (_magicNumber == (MAGIC_NUMBER ^ (size_t) this));
+    }
+
+    BlockType * getNext() const {
+      return _next;
+    }
+
+    BlockType* getPrev() const {
+      return _prev;
+    }
+
+    void setNext (BlockType* n) {
+      _next = n;
+    }
+
+    void setPrev (BlockType* p) {
+      _prev = p;
+    }
+
+    void lock() {
+      _theLock.lock();
+    }
+
+    void unlock() {
+      _theLock.unlock();
+    }
+
+    // ========== Delayed Free Queue API (for cross-thread frees) ==========
+
+    /// Push object to delayed free queue (cross-thread, lock-free).
+    inline void pushDelayedFree(void* ptr) {
+      _delayedFreeList.push(ptr);
+    }
+
+    /// Check if delayed frees are pending (relaxed; false negatives are fine).
+    inline bool hasDelayedFrees() const {
+      return !_delayedFreeList.isEmpty();
+    }
+
+    /// Drain all delayed frees into the bitmap; returns the number freed.
+    inline unsigned int drainDelayedFrees() {
+      auto* list = _delayedFreeList.popAll();
+      unsigned int count = 0;
+      while (list != nullptr) {
+        auto* next = list->next.load(std::memory_order_relaxed);
+        count += freeObject(list);
+        list = reinterpret_cast<AtomicFreeList::Entry*>(next);
+      }
+      return count;
+    }
+
+  private:
+
+    enum { MAGIC_NUMBER = 0xcafebeef };
+
+    enum { BitsPerWord = 64 };
+
+    /// The most objects a superblock can hold (all of minimum size).
+    enum { MaxObjects = SuperblockSize / MinObjectAlignment };
+
+    /// Rounded up to an even number of words for the two-word scan.
+    enum { BitmapWords = 2 * ((MaxObjects + 2 * BitsPerWord - 1) / (2 * BitsPerWord)) };
+
+    static constexpr unsigned int log2 (size_t v) {
+      return (v <= 1) ? 0 : 1 + log2 (v >> 1);
+    }
+
+    static inline unsigned int countTrailingZeros (uint64_t v) {
+      assert (v != 0);
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward64 (&index, v);
+      return (unsigned int) index;
+#else
+      return (unsigned int) __builtin_ctzll (v);
+#endif
+    }
+
+    inline size_t index (const void * ptr) const {
+      auto offset = (size_t) ptr - (size_t) _start;
+      if (_objectSizeIsPowerOfTwo) {
+	return offset >> _objectSizeShift;
+      } else {
+	return _objectSizeReciprocal.divide (offset);
+      }
+    }
+
+    /// Mark the object at ptr free; returns 0 (and does nothing) if it already was.
+    inline unsigned int freeObject (void * ptr) {
+      auto i = index (ptr);
+      assert (i < _totalObjects);
+      auto w = (unsigned int) (i / BitsPerWord);
+      auto mask = (uint64_t) 1 << (i % BitsPerWord);
+      if (_freeBits[w] & mask) {
+	// Double free: drop it.
+	return 0;
+      }
+      _freeBits[w] |= mask;
+      _objectsFree++;
+      if (w < _firstFreeWord) {
+	_firstFreeWord = w;
+      }
+      return 1;
+    }
+
+    /// The first word at or after w with a free object. There must be one.
+    INLINE unsigned int findFreeWord (unsigned int w) const {
+      assert (_objectsFree > 0);
+#if defined(__SSE2__)
+      if (w & 1) {
+	if (_freeBits[w]) {
+	  return w;
+	}
+	w++;
+      }
+      // Check two words (128 bits) at a time.
+      const auto zero = _mm_setzero_si128();
+      while (true) {
+	assert (w < BitmapWords);
+	auto v = _mm_load_si128 (reinterpret_cast<const __m128i *>(&_freeBits[w]));
+	auto isZero = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero));
+	if (isZero != 0xFFFF) {
+	  return w + ((isZero & 0xFF) == 0xFF);
+	}
+	w += 2;
+      }
+#else
+      while (_freeBits[w] == 0) {
+	assert (w < BitmapWords);
+	w++;
+      }
+      return w;
+#endif
+    }
+
+    // As in HoardSuperblockHeader, fields are grouped by who writes
+    // them, so that remote frees stay off the owner's lines.
+
+    // ---- Read-mostly.
+
+    /// A magic number used to verify validity of this header.
+    const size_t _magicNumber;
+
+    /// The object size.
+    const size_t _objectSize;
+
+    /// True iff size is a power of two.
+    const bool _objectSizeIsPowerOfTwo;
+
+    /// True while a private heap owns this superblock (see PrivateHeap).
+    bool _private;
+
+    /// log2 of the object size (meaningful only for powers of two).
+    const unsigned int _objectSizeShift;
+
+    /// Total objects in the superblock.
+    const unsigned int _totalObjects;
+
+    /// The first object.
+    char * const _start;
+
+    /// The owner of this superblock (atomic for lock-free ownership transfer).
+    std::atomic<HeapType*> _owner;
+
+    /// For dividing by the object size.
+    const Reciprocal _objectSizeReciprocal;
+
+    // ---- Owner-private.
+
+    /// The number of objects available for (re)use.
+    alignas(CACHE_LINE_SIZE) unsigned int _objectsFree;
+
+    /// No word before this one has a free object.
+    unsigned int _firstFreeWord;
+
+    /// The preceding superblock in a linked list.
+    BlockType* _prev;
+
+    /// The succeeding superblock in a linked list.
+    BlockType* _next;
+
+    /// One bit per object, set iff the object is free.
+    alignas(CACHE_LINE_SIZE) uint64_t _freeBits[BitmapWords];
+
+    // ---- Remote-writable.
+
+    /// Lock-free queue for delayed cross-thread frees.
+    alignas(CACHE_LINE_SIZE) AtomicFreeList _delayedFreeList;
+
+    /// The lock.
+    LockType _theLock;
+  };
+
+}
+
+#endif
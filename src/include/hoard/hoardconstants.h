@@ -16,14 +16,35 @@
 #ifndef HOARD_HOARDCONSTANTS_H
 #define HOARD_HOARDCONSTANTS_H
 
+// Build with -DHOARD_TINY_OBJECTS=1 to give requests of at most
+// sizeof(void *) bytes a size class of their own. Those objects are
+// only pointer-aligned, which C and C++ permit: no object that small
+// can require more. Every larger object keeps the full alignment.
+#if !defined(HOARD_TINY_OBJECTS)
+#define HOARD_TINY_OBJECTS 0
+#endif
+
 namespace Hoard {
 
   /// Cache line size for false sharing prevention.
   /// 64 bytes is standard for x86/x64 and ARM64.
   enum { CACHE_LINE_SIZE = 64 };
 
+  /// The number of cache-line 'colors' by which superblocks stagger
+  /// their first object (see HoardSuperblock). 1 disables coloring.
+  enum { SUPERBLOCK_COLORS = 16 };
+
   /// The maximum amount of memory that each TLAB may hold, in bytes.
   enum { MAX_MEMORY_PER_TLAB = 16 * 1024 * 1024UL }; // 16MB
+
+  /// The maximum amount of memory in large objects that each TLAB may
+  /// hold, and the largest object it holds, in bytes.
+  enum { MAX_LARGE_MEMORY_PER_TLAB = 4 * 1024 * 1024UL }; // 4MB
+  enum { MAX_LARGE_OBJECT_PER_TLAB = 1024 * 1024UL }; // 1MB
+
+  /// The maximum amount of memory in large objects that threads may
+  /// hand off to one another, in bytes, in all.
+  enum { MAX_LARGE_MEMORY_HANDOFF = 32 * 1024 * 1024UL }; // 32MB
   
   /// The maximum number of threads supported (sort of).
   enum { MaxThreads = 2048 };
@@ -34,6 +55,19 @@ namespace Hoard {
   /// Size, in bytes, of the largest object we will cache on a
   /// thread-local allocation buffer.
   enum { LargestSmallObject = 1024UL };
+
+  /// Size, in bytes, of the largest object carved out of the span
+  /// arenas (see SpanHeap); larger objects are mapped one by one.
+  enum { LargestMediumObject = 4 * 1024 * 1024UL };
+
+  /// Size, in bytes, of the tiny object class (0 if there is none).
+  enum { TinyObjectSize = HOARD_TINY_OBJECTS ? sizeof(void *) : 0 };
+
+  /// The alignment of objects in superblocks, other than tiny ones.
+  enum { ObjectAlignment = 2 * sizeof(void *) };
+
+  /// The alignment of the smallest objects in superblocks.
+  enum { MinObjectAlignment = HOARD_TINY_OBJECTS ? sizeof(void *) : 2 * sizeof(void *) };
     
 }
 
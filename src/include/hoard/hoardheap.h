@@ -46,21 +46,32 @@ using namespace HL;
 
 #include "thresholdheap.h"
 #include "hoardmanager.h"
+#include "privateheap.h"
 #include "addheaderheap.h"
 #include "threadpoolheap.h"
+#include "sharedthreadheap.h"
 #include "redirectfree.h"
 #include "ignoreinvalidfree.h"
+#include "recognizebigobjects.h"
 #include "conformantheap.h"
 #include "hoardsuperblock.h"
 #include "hoardsuperblockheader.h"
+#include "hoardbitmapsuperblockheader.h"
 #include "lockmallocheap.h"
 #include "alignedsuperblockheap.h"
 #include "alignedmmap.h"
 #include "globalheap.h"
 #include "hoardconstants.h"
+#include "adaptivelock.h"
+#include "profiledlock.h"
 
 #include "thresholdsegheap.h"
 #include "geometricsizeclass.h"
+#include "smallsizeclass.h"
+#include "tinyansiwrapper.h"
+#include "spanheap.h"
+#include "spancache.h"
+#include "mediumhybridheap.h"
 
 // Note from Emery Berger: I plan to eventually eliminate the use of
 // the spin lock, since the right place to do locking is in an
@@ -80,6 +91,65 @@ typedef HL::SpinLockType TheLockType;
 typedef HL::SpinLockType TheLockType;
 #endif
 
+// Locks for the two contended layers can be chosen independently:
+// TheGlobalHeapLockType guards the global heap (ProcessHeap) that all
+// threads share, while ThePerThreadLockType guards each per-thread
+// heap and its size-class bins. On Linux, the global heap defaults to
+// the adaptive spin-then-futex lock, so that a thread preempted while
+// holding it (e.g., when threads outnumber cores) does not leave every
+// other thread spinning out its quantum. Set HOARD_ADAPTIVE_GLOBAL_LOCK
+// or HOARD_ADAPTIVE_PERTHREAD_LOCK to 0 or 1 to override either choice.
+// Superblock headers always use TheLockType, since superblocks move
+// between the two layers.
+
+#if defined(__linux__)
+#if !defined(HOARD_ADAPTIVE_GLOBAL_LOCK)
+#define HOARD_ADAPTIVE_GLOBAL_LOCK 1
+#endif
+#if !defined(HOARD_ADAPTIVE_PERTHREAD_LOCK)
+#define HOARD_ADAPTIVE_PERTHREAD_LOCK 0
+#endif
+#endif
+
+#if HOARD_ADAPTIVE_GLOBAL_LOCK
+typedef Hoard::AdaptiveLock TheGlobalHeapLockType;
+#else
+typedef TheLockType TheGlobalHeapLockType;
+#endif
+
+#if HOARD_ADAPTIVE_PERTHREAD_LOCK
+typedef Hoard::AdaptiveLock ThePerThreadLockType;
+#else
+typedef TheLockType ThePerThreadLockType;
+#endif
+
+// Superblock headers track free objects with an intrusive freelist by
+// default. Set HOARD_BITMAP_SUPERBLOCKS to 1 to use a per-object bitmap
+// instead (see HoardBitmapSuperblockHeader). This is a macro rather
+// than an alias template because headers name their own HoardSuperblock
+// type, and compilers disagree on whether an alias template makes the
+// same HoardSuperblock type as the template it stands for.
+
+#if !defined(HOARD_BITMAP_SUPERBLOCKS)
+#define HOARD_BITMAP_SUPERBLOCKS 0
+#endif
+
+#if HOARD_BITMAP_SUPERBLOCKS
+#define HOARD_SUPERBLOCK_HEADER Hoard::HoardBitmapSuperblockHeader
+#else
+#define HOARD_SUPERBLOCK_HEADER Hoard::HoardSuperblockHeader
+#endif
+
+// Objects larger than the superblock classes but no larger than
+// LargestMediumObject come from spans carved out of shared arenas (see
+// SpanHeap), instead of each getting its own mapping from the big-object
+// heap. Set HOARD_MEDIUM_OBJECTS to 0 to send them to the big-object
+// heap as before.
+
+#if !defined(HOARD_MEDIUM_OBJECTS)
+#define HOARD_MEDIUM_OBJECTS 1
+#endif
+
 #if defined(__clang__)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-variable"
@@ -87,13 +157,15 @@ typedef HL::SpinLockType TheLockType;
 
 namespace Hoard {
 
-  class MmapSource : public AlignedMmap<SUPERBLOCK_SIZE, TheLockType> {};
+  class MmapSource : public AlignedMmap<SUPERBLOCK_SIZE, SiteLock<TheLockType, LockSite::MmapSource>> {};
   
   //
   // There is just one "global" heap, shared by all of the per-process heaps.
   //
 
-  typedef GlobalHeap<SUPERBLOCK_SIZE, HoardSuperblockHeader, EMPTINESS_CLASSES, MmapSource, TheLockType>
+  typedef GlobalHeap<SUPERBLOCK_SIZE, HOARD_SUPERBLOCK_HEADER, EMPTINESS_CLASSES, MmapSource, TheLockType,
+		     SiteLock<TheGlobalHeapLockType, LockSite::GlobalHeap>,
+		     SiteLock<TheGlobalHeapLockType, LockSite::GlobalBin>>
   TheGlobalHeap;
   
   //
@@ -104,8 +176,8 @@ namespace Hoard {
 
   class hoardThresholdFunctionClass {
   public:
-    inline static bool function (unsigned int u,
-				 unsigned int a,
+    inline static bool function (uint64_t u,
+				 uint64_t a,
 				 size_t objSize)
     {
       /*
@@ -123,7 +195,7 @@ namespace Hoard {
   class SmallHeap;
   
   //  typedef Hoard::HoardSuperblockHeader<TheLockType, SUPERBLOCK_SIZE, SmallHeap> HSHeader;
-  typedef HoardSuperblock<TheLockType, SUPERBLOCK_SIZE, SmallHeap, Hoard::HoardSuperblockHeader> SmallSuperblockType;
+  typedef HoardSuperblock<TheLockType, SUPERBLOCK_SIZE, SmallHeap, HOARD_SUPERBLOCK_HEADER> SmallSuperblockType;
 
   //
   // The heap that manages small objects.
@@ -134,13 +206,18 @@ namespace Hoard {
 		 TheGlobalHeap,
 		 SmallSuperblockType,
 		 EMPTINESS_CLASSES,
-		 TheLockType,
+		 SiteLock<ThePerThreadLockType, LockSite::PerThreadHeap>,
 		 hoardThresholdFunctionClass,
-		 SmallHeap> > 
+		 SmallHeap,
+		 SiteLock<ThePerThreadLockType, LockSite::PerThreadBin>> > 
   {};
 
   class BigHeap;
 
+  // Big objects each have a header of their own, and no objects to
+  // track, so they keep the (smaller) freelist header whichever one
+  // superblocks use.
+
   typedef HoardSuperblock<TheLockType,
 			  SUPERBLOCK_SIZE,
 			  BigHeap,
@@ -169,22 +246,52 @@ namespace Hoard {
 					    SUPERBLOCK_SIZE,
 					    MmapSource> {};
 
-  typedef HL::ThreadHeap<64, HL::LockedHeap<TheLockType,
-					    ThresholdSegHeap<25,      // % waste
-							     1048576, // at least 1MB in any heap
-							     80,      // num size classes
-							     GeometricSizeClass<20>::size2class,
-							     GeometricSizeClass<20>::class2size,
-							     GeometricSizeClass<20>::MaxObjectSize,
-							     AdaptHeap<DLList, objectSource>,
-							     objectSource> > >
+  // The heaps are shared so that realloc can resize objects in them.
+
+  typedef SharedThreadHeap<64, HL::LockedHeap<SiteLock<TheLockType, LockSite::BigHeap>,
+					      ThresholdSegHeap<25,      // % waste
+							       1048576, // at least 1MB in any heap
+							       80,      // num size classes
+							       GeometricSizeClass<20>::size2class,
+							       GeometricSizeClass<20>::class2size,
+							       GeometricSizeClass<20>::MaxObjectSize,
+							       AdaptHeap<DLList, objectSource>,
+							       objectSource> > >
   bigHeapType;
 #endif
 
   class BigHeap : public bigHeapType {};
 
+  // The heap that manages medium objects: one set of span arenas,
+  // shared by all threads, behind per-thread caches of freed spans.
+
+  typedef SpanHeap<32 * 1048576,          // arena size
+		   HL::MmapWrapper::Size, // span granularity
+		   25,                    // % of in-use memory kept dirty
+		   32 * 1048576>          // dirty memory always allowed
+  MediumSpans;
+
+  // The arenas sit behind one lock: a SharedThreadHeap with one heap
+  // (rather than an ExactlyOneHeap), so that calloc can reach it.
+
+  class MediumSpanSource :
+    public SharedThreadHeap<1, HL::LockedHeap<SiteLock<TheLockType, LockSite::MediumHeap>,
+					      MediumSpans> > {};
+
+  typedef HL::ThreadHeap<64, HL::LockedHeap<SiteLock<TheLockType, LockSite::MediumCache>,
+					    SpanCache<2 * 1048576, // bytes cached per heap
+						      1048576,     // largest span cached
+						      MediumSpans,
+						      MediumSpanSource> > >
+  mediumHeapType;
+
+  class MediumHeap : public mediumHeapType {};
+
   enum { BigObjectSize = 
-	 HL::bins<SmallSuperblockType::Header, SUPERBLOCK_SIZE>::BIG_OBJECT };
+	 SmallSizeClass<SmallSuperblockType::Header, SUPERBLOCK_SIZE>::BIG_OBJECT };
+
+  static_assert(SmallSizeClass<SmallSuperblockType::Header, SUPERBLOCK_SIZE>::test(),
+		"Small size classes are inconsistent.");
 
   //
   // Each thread has its own heap for small objects.
@@ -198,26 +305,58 @@ namespace Hoard {
     // preventing false sharing when heaps are stored in arrays.
     char _padding[CACHE_LINE_SIZE];
   };
+
+  //
+  // Private heaps (see hoard_heap_create) hold small objects that are
+  // all freed at once, by handing their superblocks back to the global
+  // heap.
+  //
+
+  class PrivateHoardHeap;
+
+  typedef HoardSuperblock<TheLockType, SUPERBLOCK_SIZE, PrivateHoardHeap, HOARD_SUPERBLOCK_HEADER> PrivateSuperblockType;
+
+  class PrivateHoardHeap :
+    public PrivateHeap<
+    LockMallocHeap<
+    HoardManager<NoSuperblockSource,
+		 PrivateHeapParent<TheGlobalHeap,
+				   AlignedSuperblockHeap<TheLockType, SUPERBLOCK_SIZE, MmapSource>,
+				   PrivateSuperblockType,
+				   SUPERBLOCK_SIZE>,
+		 PrivateSuperblockType,
+		 EMPTINESS_CLASSES,
+		 SiteLock<ThePerThreadLockType, LockSite::PrivateHeap>,
+		 privateThresholdFunctionClass,
+		 PrivateHoardHeap,
+		 SiteLock<ThePerThreadLockType, LockSite::PrivateBin>> > >
+  {};
   
 
   template <int N, int NH>
-  class HoardHeap :
-    public HL::ANSIWrapper<
+  using SuperblockOrBigHeap =
     IgnoreInvalidFree<
       HL::HybridHeap<Hoard::BigObjectSize,
-		     ThreadPoolHeap<N, NH, Hoard::PerThreadHoardHeap>,
-		     Hoard::BigHeap> > >
+		     RecognizeBigObjects<ThreadPoolHeap<N, NH, Hoard::PerThreadHoardHeap>,
+					 Hoard::BigSuperblockType>,
+		     Hoard::BigHeap> >;
+
+  template <int N, int NH>
+  class HoardHeap :
+#if HOARD_MEDIUM_OBJECTS
+    public TinyANSIWrapper<
+    MediumHybridHeap<Hoard::BigObjectSize,
+		     LargestMediumObject,
+		     Hoard::MediumSpans,
+		     Hoard::MediumHeap,
+		     SuperblockOrBigHeap<N, NH> > >
+#else
+    public TinyANSIWrapper<SuperblockOrBigHeap<N, NH> >
+#endif
   {
   public:
     
     enum { BIG_OBJECT = Hoard::BigObjectSize };
-    
-    HoardHeap() {
-      enum { BIG_HEADERS = sizeof(Hoard::BigSuperblockType::Header),
-	     SMALL_HEADERS = sizeof(Hoard::SmallSuperblockType::Header)};
-      static_assert(BIG_HEADERS == SMALL_HEADERS,
-		    "Headers must be the same size.");
-    }
   };
 
 }
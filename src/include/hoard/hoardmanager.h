@@ -16,6 +16,7 @@
 #ifndef HOARD_HOARDMANAGER_H
 #define HOARD_HOARDMANAGER_H
 
+#include <cstdint>
 #include <cstdlib>
 #include <new>
 #include <mutex>
@@ -27,6 +28,8 @@
 #include "manageonesuperblock.h"
 #include "basehoardmanager.h"
 #include "emptyhoardmanager.h"
+#include "hoardconstants.h"
+#include "smallsizeclass.h"
 
 
 #include "heaplayers.h"
@@ -49,7 +52,8 @@ namespace Hoard {
 	    int EmptinessClasses,
 	    class LockType,
 	    class thresholdFunctionClass,
-	    class HeapType>
+	    class HeapType,
+	    class BinLockType = LockType>
   class HoardManager : public BaseHoardManager<SuperblockType_>,
 		       public thresholdFunctionClass
   {
@@ -79,22 +83,46 @@ namespace Hoard {
 	ptr = slowPathMalloc (realSize);
       }
       assert (SuperHeap::getSize(ptr) >= sz);
-      assert ((size_t) ptr % Alignment == 0);
+      assert ((size_t) ptr % MinObjectAlignment == 0);
       return ptr;
     }
 
+    /// Put n objects of sz bytes into ptrs, taking the bin lock once
+    /// for every superblock they come from. Returns how many it got
+    /// (fewer than n only if memory runs out).
+    INLINE size_t mallocBatch (size_t sz, size_t n, void ** ptrs)
+    {
+      Check<HoardManager, sanityCheck> check (this);
+      const auto binIndex = binType::getSizeClass(sz);
+      const auto realSize = binType::getClassSize(binIndex);
+      assert (realSize >= sz);
+
+      size_t got = 0;
+      while (got < n) {
+	got += getObjects (binIndex, realSize, n - got, ptrs + got);
+	if ((got < n) && !getAnotherSuperblock (realSize)) {
+	  break;
+	}
+      }
+      return got;
+    }
+
 
     /// Put a superblock on this heap.
     NO_INLINE void put (SuperblockType * s, size_t sz) {
       assert (s->getOwner() != this);
+      // An exclusive owner skips the bin locks (see getObjects), so
+      // nobody else may touch its bins, locked or not.
+      assert (!SuperHeap::isExclusive() || SuperHeap::isCurrentThreadOwner());
       Check<HoardManager, sanityCheck> check (this);
 
       const auto binIndex = binType::getSizeClass(sz);
 
       // Check to see whether this superblock puts us over.
       // Use eventually consistent stats for threshold check.
-      auto a = _stats(binIndex).getAllocated() + s->getTotalObjects();
-      auto u = _stats(binIndex).getInUse() + (s->getTotalObjects() - s->getObjectsFree());
+      auto& remote = _remoteStats(binIndex);
+      auto a = _stats(binIndex).getAllocated() + remote.pendingAllocated() + s->getTotalObjects();
+      auto u = _stats(binIndex).getInUse() + remote.pendingInUse() + (s->getTotalObjects() - s->getObjectsFree());
 
       if (thresholdFunctionClass::function (u, a, sz)) {
 	// We've crossed the threshold function,
@@ -111,63 +139,13 @@ namespace Hoard {
 
     /// Get an empty (or nearly-empty) superblock.
     NO_INLINE SuperblockType * get (size_t sz, HeapType * dest) {
-      Check<HoardManager, sanityCheck> check (this);
-      const auto binIndex = binType::getSizeClass (sz);
-
-      // Acquire per-bin lock for getting superblock.
-      _otherBins(binIndex).lock();
-
-      auto * s = _otherBins(binIndex).get();
-      if (s) {
-	assert (s->isValidSuperblock());
-
-	// Update the statistics, removing objects in use and allocated for s.
-	decStatsSuperblock (s, binIndex);
-	s->setOwner (dest);
-      }
-
-      _otherBins(binIndex).unlock();
-
-      // printf ("getting sb %x (size %d) on %x\n", (void *) s, sz, (void *) this);
-      return s;
+      return takeSuperblock (sz, dest, false);
     }
 
-    /// Return one object to its superblock and update stats.
-    INLINE void free (void * ptr) {
-      Check<HoardManager, sanityCheck> check (this);
-
-      // Get the corresponding superblock.
-      SuperblockType * s = SuperHeap::getSuperblock (ptr);
-
-      assert (s->getOwner() == this);
-
-      // Find out which bin it belongs to.
-      // Note that we assume that all pointers have been correctly
-      // normalized at this point.
-      assert (s->normalize (ptr) == ptr);
-
-      auto sz = s->getObjectSize ();
-      auto binIndex = (int) binType::getSizeClass (sz);
-
-      // Acquire per-bin lock for bin operations.
-      _otherBins(binIndex).lock();
-
-      // Free the object (handles emptiness class transfer internally).
-      _otherBins(binIndex).freeUnlocked (ptr);
-
-      _otherBins(binIndex).unlock();
-
-      // Update statistics atomically (outside lock).
-      _stats(binIndex).decrementInUse();
-
-      // Free up a superblock if we've crossed the emptiness threshold.
-      // Use eventually consistent stats (safe due to hysteresis).
-      auto u = _stats(binIndex).getInUse();
-      auto a = _stats(binIndex).getAllocated();
-
-      if (thresholdFunctionClass::function (u, a, sz)) {
-	slowPathFree (binIndex, u, a);
-      }
+    /// Get a completely empty superblock, or null if there is none at
+    /// hand (the bin's cached superblock is not checked).
+    NO_INLINE SuperblockType * getEmpty (size_t sz, HeapType * dest) {
+      return takeSuperblock (sz, dest, true);
     }
 
     INLINE void lock() {
@@ -180,13 +158,64 @@ namespace Hoard {
 
     /// Drain all delayed frees from all bins (called on thread exit).
     void drainAllDelayedFrees() {
+      const bool exclusive = SuperHeap::isCurrentThreadOwner();
+      if (!exclusive) {
+        // Hold the heap lock throughout: a thread becomes the owner
+        // only under it (see ThreadPoolHeap::setHeapOwner), and the
+        // owner touches the bins without their locks.
+        _theLock.lock();
+        if (SuperHeap::isExclusive()) {
+          // Another thread owns this heap outright and drains it itself.
+          _theLock.unlock();
+          return;
+        }
+      }
       for (int binIndex = 0; binIndex < NumBins; binIndex++) {
-        // Acquire per-bin lock.
-        _otherBins(binIndex).lock();
-        auto u = _stats(binIndex).getInUse();
-        _otherBins(binIndex).drainDelayedFrees(&u);
-        _stats(binIndex).setInUse(u);
-        _otherBins(binIndex).unlock();
+        // Acquire per-bin lock (unless we are the exclusive owner).
+        lockBin (binIndex, exclusive);
+        auto freed = _otherBins(binIndex).drainDelayedFrees(nullptr);
+        unlockBin (binIndex, exclusive);
+        if (freed == 0) {
+          continue;
+        }
+        if (exclusive) {
+          _stats(binIndex).adjustForSuperblock (-(int64_t) freed, 0);
+        } else {
+          // Someone else may be mallocing from this heap right now.
+          _remoteStats(binIndex).adjust (-(int64_t) freed, 0);
+        }
+      }
+      if (!exclusive) {
+        _theLock.unlock();
+      }
+    }
+
+    /// Give every superblock to the parent heap, emptied: everything
+    /// allocated from this heap is freed at once. Takes time in the
+    /// number of superblocks, not objects (see PrivateHeap).
+    NO_INLINE void releaseAll() {
+      assert (!SuperHeap::isExclusive() || SuperHeap::isCurrentThreadOwner());
+      Check<HoardManager, sanityCheck> check (this);
+      for (int binIndex = 0; binIndex < NumBins; binIndex++) {
+	auto sz = binType::getClassSize (binIndex);
+	while (true) {
+	  _otherBins(binIndex).lock();
+	  auto * sb = _otherBins(binIndex).getAny();
+	  _otherBins(binIndex).unlock();
+	  if (!sb) {
+	    break;
+	  }
+	  // Pending remote frees would otherwise land on the cleared
+	  // superblock's next owner.
+	  sb->drainDelayedFrees();
+	  sb->clear();
+	  // Give it to the parent outside the lock.
+	  _ph.put (reinterpret_cast<typename ParentHeap::SuperblockType *>(sb), sz);
+	}
+	_stats(binIndex).setInUse (0);
+	_stats(binIndex).setAllocated (0);
+	int64_t inUse, allocated;
+	_remoteStats(binIndex).take (inUse, allocated);
       }
     }
 
@@ -218,7 +247,7 @@ namespace Hoard {
         auto* oldHoardManager = static_cast<HoardManager*>(
           static_cast<void*>(oldOwner));
         oldHoardManager->_otherBins(binIndex).removeSuperblock(s);
-        oldHoardManager->decStatsSuperblock(s, binIndex);
+        oldHoardManager->remoteDecStatsSuperblock(s, binIndex);
         oldOwner->unlock();
       }
 
@@ -245,9 +274,8 @@ namespace Hoard {
       // Check emptiness threshold
       auto a = stats.getAllocated();
       if (thresholdFunctionClass::function(u - 1, a, sz)) {
-        // Release lock before calling slowPathFree (it will reacquire)
-        // Actually, we're already holding the lock, so we need to handle this differently
-        // For now, skip the threshold check - the next free will trigger it if needed
+        // We hold the heap lock here, so we can't hand a superblock to
+        // the parent; for now, skip the threshold check.
       }
     }
 
@@ -275,44 +303,35 @@ namespace Hoard {
 
 
     /// The type of the bin manager.
-    typedef HL::bins<typename SuperblockType::Header, SuperblockSize> binType;
+    typedef SmallSizeClass<typename SuperblockType::Header, SuperblockSize> binType;
 
     /// How many bins do we need to maintain?
     enum { NumBins = binType::NUM_BINS };
 
-    NO_INLINE void slowPathFree (int binIndex, unsigned int u, unsigned int a) {
-      // We've crossed the threshold.
-      // Remove a superblock and give it to the 'parent heap.'
+    /// Remove a superblock from its bin and hand it to dest.
+    SuperblockType * takeSuperblock (size_t sz, HeapType * dest, bool emptyOnly) {
+      assert (!SuperHeap::isExclusive() || SuperHeap::isCurrentThreadOwner());
       Check<HoardManager, sanityCheck> check (this);
+      const auto binIndex = binType::getSizeClass (sz);
 
       // Acquire per-bin lock for getting superblock.
       _otherBins(binIndex).lock();
 
-      SuperblockType * sb = _otherBins(binIndex).get ();
-
-      if (sb) {
-	auto sz = binType::getClassSize (binIndex);
-	auto totalObjects = sb->getTotalObjects();
+      auto * s = emptyOnly ? _otherBins(binIndex).getEmpty() : _otherBins(binIndex).get();
+      if (s) {
+	assert (s->isValidSuperblock());
 
-	// Update stats atomically.
-	_stats(binIndex).adjustForSuperblock(
-	  -(int)(totalObjects - sb->getObjectsFree()),  // inUse delta
-	  -(int)totalObjects                             // allocated delta
-	);
+	// Update the statistics, removing objects in use and allocated for s.
+	decStatsSuperblock (s, binIndex);
+	s->setOwner (dest);
+      }
 
-	_otherBins(binIndex).unlock();
+      _otherBins(binIndex).unlock();
 
-	// Give it to the parent heap (outside lock).
-	///////// NOTE: We change the superblock type here!
-	///////// THIS HAD BETTER BE SAFE!
-	_ph.put (reinterpret_cast<typename ParentHeap::SuperblockType *>(sb), sz);
-	assert (sb->isValidSuperblock());
-      } else {
-	_otherBins(binIndex).unlock();
-      }
+      // printf ("getting sb %x (size %d) on %x\n", (void *) s, sz, (void *) this);
+      return s;
     }
 
-
     NO_INLINE void unlocked_put (SuperblockType * s, size_t sz) {
       if (!s || !s->isValidSuperblock()) {
 	return;
@@ -338,8 +357,8 @@ namespace Hoard {
       auto totalObjects = s->getTotalObjects();
       auto objectsInUse = totalObjects - s->getObjectsFree();
       _stats(binIndex).adjustForSuperblock(
-        static_cast<int>(objectsInUse),     // inUse delta
-        static_cast<int>(totalObjects)      // allocated delta
+        static_cast<int64_t>(objectsInUse),     // inUse delta
+        static_cast<int64_t>(totalObjects)      // allocated delta
       );
     }
 
@@ -348,8 +367,18 @@ namespace Hoard {
       auto totalObjects = s->getTotalObjects();
       auto objectsInUse = totalObjects - s->getObjectsFree();
       _stats(binIndex).adjustForSuperblock(
-        -static_cast<int>(objectsInUse),    // inUse delta
-        -static_cast<int>(totalObjects)     // allocated delta
+        -static_cast<int64_t>(objectsInUse),    // inUse delta
+        -static_cast<int64_t>(totalObjects)     // allocated delta
+      );
+    }
+
+    /// As above, for a thread that does not own this heap.
+    void remoteDecStatsSuperblock (SuperblockType * s, int binIndex) {
+      auto totalObjects = s->getTotalObjects();
+      auto objectsInUse = totalObjects - s->getObjectsFree();
+      _remoteStats(binIndex).adjust(
+        -static_cast<int64_t>(objectsInUse),    // inUse delta
+        -static_cast<int64_t>(totalObjects)     // allocated delta
       );
     }
 
@@ -376,33 +405,79 @@ namespace Hoard {
     /// Get one object of a particular size.
     MALLOC_FUNCTION INLINE void * getObject (int binIndex,
 					     size_t sz) {
+      void * ptr = nullptr;
+      getObjects (binIndex, sz, 1, &ptr);
+      return ptr;
+    }
+
+    /// Get up to n objects of a particular size from the superblocks
+    /// already in the bin; returns how many.
+    INLINE size_t getObjects (int binIndex,
+			      size_t sz,
+			      size_t n,
+			      void ** ptrs) {
       Check<HoardManager, sanityCheck> check (this);
 
-      // Acquire per-bin lock for bin operations.
-      _otherBins(binIndex).lock();
+      // Acquire per-bin lock for bin operations. A heap's exclusive
+      // owner is the only thread that can reach its bins (remote frees
+      // go through the delayed free queue), so it skips the lock.
+      const bool exclusive = SuperHeap::isCurrentThreadOwner();
+      lockBin (binIndex, exclusive);
+
+      auto& stats = _stats(binIndex);
 
-      // Opportunistic drain: process cross-thread frees before allocating.
-      // This handles delayed frees pushed by other threads via pushDelayedFree().
+      // Fold in statistics updates posted by other threads.
+      stats.fold (_remoteStats(binIndex));
+
+      size_t got = takeObjects (binIndex, sz, n, ptrs);
+
+      // Out of room: before the caller fetches another superblock,
+      // reclaim objects that other threads freed into ours (they
+      // push them via pushDelayedFree()). Draining visits every
+      // superblock in the bin, so we don't do it on every call.
       unsigned int freedCount = 0;
-      {
-        // drainDelayedFrees iterates superblocks and may transfer between emptiness classes
-        auto u = _stats(binIndex).getInUse();
-        freedCount = _otherBins(binIndex).drainDelayedFrees(&u);
-        if (freedCount > 0) {
-          // Stats already decremented inside drainDelayedFrees via the pointer
-          _stats(binIndex).setInUse(u);
-        }
+      if (got < n) {
+	freedCount = _otherBins(binIndex).drainDelayedFrees(nullptr);
+	if (freedCount) {
+	  got += takeObjects (binIndex, sz, n - got, ptrs + got);
+	}
       }
 
-      void * ptr = _otherBins(binIndex).malloc (sz);
+      unlockBin (binIndex, exclusive);
 
-      _otherBins(binIndex).unlock();
+      // We own these counters (exclusively, or via the heap lock), so
+      // this is a plain update, and it can wait until the bin lock
+      // (which only guards the superblocks) is released.
+      stats.setInUse (stats.getInUse() - freedCount + got);
+      return got;
+    }
 
-      if (ptr) {
-	// We got one. Update stats atomically (outside lock).
-	_stats(binIndex).incrementInUse();
+    /// Take up to n objects from the bin (whose lock we hold, if any).
+    INLINE size_t takeObjects (int binIndex,
+			       size_t sz,
+			       size_t n,
+			       void ** ptrs) {
+      size_t got = 0;
+      while (got < n) {
+	void * ptr = _otherBins(binIndex).malloc (sz);
+	if (!ptr) {
+	  break;
+	}
+	ptrs[got++] = ptr;
+      }
+      return got;
+    }
+
+    INLINE void lockBin (int binIndex, bool exclusive) {
+      if (!exclusive) {
+	_otherBins(binIndex).lock();
+      }
+    }
+
+    INLINE void unlockBin (int binIndex, bool exclusive) {
+      if (!exclusive) {
+	_otherBins(binIndex).unlock();
       }
-      return ptr;
     }
 
     friend class sanityCheck;
@@ -459,9 +534,14 @@ namespace Hoard {
     /// Usage statistics for each bin.
     Array<NumBins, Statistics> _stats;
 
+    /// Statistics updates from other threads. The array as a whole
+    /// starts a cache line of its own, away from _stats; its bins'
+    /// entries are not padded apart from each other.
+    alignas(CACHE_LINE_SIZE) Array<NumBins, RemoteStatistics> _remoteStats;
+
     typedef SuperblockType * SuperblockTypePointer;
 
-    typedef EmptyClass<SuperblockType, EmptinessClasses> OrganizedByEmptiness;
+    typedef EmptyClass<SuperblockType, EmptinessClasses, BinLockType> OrganizedByEmptiness;
 
     typedef ManageOneSuperblock<OrganizedByEmptiness> BinManager;
 
@@ -20,6 +20,15 @@
 #include <cstdlib>
 
 #include "heaplayers.h"
+#include "hoardconstants.h"
+#include "../superblocks/superblockmetadata.h"
+
+// Build with -DHOARD_OUT_OF_LINE_METADATA=1 to keep small-object
+// superblock headers in a separate table (see SuperblockMetadataTable)
+// instead of at the front of each superblock.
+#if !defined(HOARD_OUT_OF_LINE_METADATA)
+#define HOARD_OUT_OF_LINE_METADATA 0
+#endif
 
 namespace Hoard {
 
@@ -33,9 +42,21 @@ namespace Hoard {
   public:
 
     HoardSuperblock (size_t sz)
-      : _header (sz, BufferSize)
+#if !HOARD_OUT_OF_LINE_METADATA
+      : _header (sz, BufferSize, colorOffset (this, sz))
+#endif
     {
-      assert (_header.isValid());
+#if HOARD_OUT_OF_LINE_METADATA
+      auto * slot = Metadata::get (this);
+      if (slot) {
+	new (slot) Header (sz, BufferSize, colorOffset (this, sz), _buf);
+      } else {
+	// No table entry for this address: put the header in front,
+	// where header() will find it.
+	new (_buf) Header (sz, BufferSize, sizeof(Header) + colorOffset (this, sz + sizeof(Header)), _buf);
+      }
+#endif
+      assert (header().isValid());
       assert (this == (HoardSuperblock *)
 	      (((size_t) this) & ~((size_t) SuperblockSize-1)));
     }
@@ -48,8 +69,9 @@ namespace Hoard {
     }
 
     constexpr INLINE size_t getSize (void * ptr) const {
-      if (_header.isValid() && inRange (ptr)) {
-	return _header.getSize (ptr);
+      auto& h = header();
+      if (h.isValid() && inRange (h, ptr)) {
+	return h.getSize (ptr);
       } else {
 	return 0;
       }
@@ -57,110 +79,123 @@ namespace Hoard {
 
 
     constexpr INLINE size_t getObjectSize() const {
-      if (_header.isValid()) {
-	return _header.getObjectSize();
+      auto& h = header();
+      if (h.isValid()) {
+	return h.getObjectSize();
       } else {
 	return 0;
       }
     }
 
     MALLOC_FUNCTION INLINE void * malloc (size_t) {
-      assert (_header.isValid());
-      auto * ptr = _header.malloc();
+      auto& h = header();
+      assert (h.isValid());
+      auto * ptr = h.malloc();
       if (ptr) {
 	assert (inRange (ptr));
-	assert ((size_t) ptr % HeapType::Alignment == 0);
+	assert ((size_t) ptr % MinObjectAlignment == 0);
       }
       return ptr;
     }
 
     INLINE void free (void * ptr) {
-      if (_header.isValid() && inRange (ptr)) {
+      auto& h = header();
+      if (h.isValid() && inRange (h, ptr)) {
 	// Pointer is in range.
-	_header.free (ptr);
+	h.free (ptr);
       } else {
 	// Invalid free.
       }
     }
     
     void clear() {
-      if (_header.isValid()) {
-	_header.clear();
+      auto& h = header();
+      if (h.isValid()) {
+	h.clear();
       }
     }
     
     // ----- below here are non-conventional heap methods ----- //
     
     constexpr INLINE bool isValidSuperblock() const {
-      auto b = _header.isValid();
+      auto b = header().isValid();
       return b;
     }
     
     constexpr INLINE unsigned int getTotalObjects() const {
-      assert (_header.isValid());
-      return _header.getTotalObjects();
+      assert (header().isValid());
+      return header().getTotalObjects();
     }
     
     /// Return the number of free objects in this superblock.
     constexpr INLINE unsigned int getObjectsFree() const {
-      assert (_header.isValid());
-      assert (_header.getObjectsFree() >= 0);
-      assert (_header.getObjectsFree() <= _header.getTotalObjects());
-      return _header.getObjectsFree();
+      auto& h = header();
+      assert (h.isValid());
+      assert (h.getObjectsFree() >= 0);
+      assert (h.getObjectsFree() <= h.getTotalObjects());
+      return h.getObjectsFree();
     }
     
     inline void lock() {
-      assert (_header.isValid());
-      _header.lock();
+      assert (header().isValid());
+      header().lock();
     }
     
     inline void unlock() {
-      assert (_header.isValid());
-      _header.unlock();
+      assert (header().isValid());
+      header().unlock();
     }
     
     constexpr inline HeapType * getOwner() const {
-      assert (_header.isValid());
-      return _header.getOwner();
+      assert (header().isValid());
+      return header().getOwner();
     }
 
     inline void setOwner (HeapType * o) {
-      assert (_header.isValid());
+      assert (header().isValid());
       assert (o != nullptr);
-      _header.setOwner (o);
+      header().setOwner (o);
     }
-    
+
+    /// True while a private heap owns this superblock: its objects
+    /// must go back to it, never into a thread's local heap.
+    constexpr INLINE bool isPrivate() const {
+      return header().isPrivate();
+    }
+
+    inline void setPrivate (bool p) {
+      assert (header().isValid());
+      header().setPrivate (p);
+    }
+
     constexpr inline HoardSuperblock * getNext() const {
-      assert (_header.isValid());
-      return _header.getNext();
+      assert (header().isValid());
+      return header().getNext();
     }
 
     constexpr inline HoardSuperblock * getPrev() const {
-      assert (_header.isValid());
-      return _header.getPrev();
+      assert (header().isValid());
+      return header().getPrev();
     }
     
     inline void setNext (HoardSuperblock * f) {
-      assert (_header.isValid());
+      assert (header().isValid());
       assert (f != this);
-      _header.setNext (f);
+      header().setNext (f);
     }
     
     inline void setPrev (HoardSuperblock * f) {
-      assert (_header.isValid());
+      assert (header().isValid());
       assert (f != this);
-      _header.setPrev (f);
+      header().setPrev (f);
     }
     
     constexpr INLINE bool inRange (void * ptr) const {
-      // Returns true iff the pointer is valid.
-      auto ptrValue = (size_t) ptr;
-      return ((ptrValue >= (size_t) _buf) &&
-	      (ptrValue < (size_t) &_buf[BufferSize]));
+      return inRange (header(), ptr);
     }
     
     constexpr INLINE void * normalize (void * ptr) const {
-      auto * ptr2 = _header.normalize (ptr);
+      auto * ptr2 = header().normalize (ptr);
       assert (inRange (ptr));
       assert (inRange (ptr2));
       return ptr2;
@@ -170,22 +205,22 @@ namespace Hoard {
 
     /// Push to delayed free queue (cross-thread, lock-free).
     inline void pushDelayedFree(void* ptr) {
-      _header.pushDelayedFree(ptr);
+      header().pushDelayedFree(ptr);
     }
 
     /// Check if delayed frees are pending.
     inline bool hasDelayedFrees() const {
-      return _header.hasDelayedFrees();
+      return header().hasDelayedFrees();
     }
 
     /// Drain all delayed frees to local freelist.
     inline unsigned int drainDelayedFrees() {
-      return _header.drainDelayedFrees();
+      return header().drainDelayedFrees();
     }
 
     /// Try atomic ownership claim (for lock-free reclaim).
     inline bool tryClaimOwnership(HeapType* expected, HeapType* newOwner) {
-      return _header.tryClaimOwnership(expected, newOwner);
+      return header().tryClaimOwnership(expected, newOwner);
     }
 
     typedef Header_<LockType, SuperblockSize, HeapType> Header;
@@ -198,13 +233,59 @@ namespace Hoard {
     HoardSuperblock (const HoardSuperblock&);
     HoardSuperblock& operator=(const HoardSuperblock&);
     
+#if HOARD_OUT_OF_LINE_METADATA
+    enum { BufferSize = SuperblockSize };
+#else
     enum { BufferSize = SuperblockSize - sizeof(Header) };
+#endif
+
+    typedef SuperblockMetadataTable<SuperblockSize, sizeof(Header)> Metadata;
+
+    /// The metadata for this superblock.
+    INLINE Header& header() const {
+#if HOARD_OUT_OF_LINE_METADATA
+      auto * h = reinterpret_cast<Header *>(Metadata::find (this));
+      if (h && h->isValid()) {
+	return *h;
+      }
+      // Not in the table: either we could not get this superblock a
+      // slot, or this is really a big object, whose header
+      // (from AddHeaderHeap) is always in front.
+      return *reinterpret_cast<Header *>(const_cast<char *>(_buf));
+#else
+      return const_cast<Header&>(_header);
+#endif
+    }
+
+    INLINE bool inRange (const Header& h, void * ptr) const {
+      // Returns true iff the pointer is valid.
+      auto ptrValue = (size_t) ptr;
+      return ((ptrValue >= (size_t) h.getStart()) &&
+	      (ptrValue < (size_t) &_buf[BufferSize]));
+    }
+
+    /// How far to shift the first object past the header.
+    ///
+    /// Superblocks are SuperblockSize-aligned, so without this their
+    /// first objects would all map to the same few cache sets and
+    /// conflict with one another. We instead rotate through
+    /// SUPERBLOCK_COLORS cache-line offsets, chosen by address so that
+    /// neighboring superblocks get different colors. This costs at most
+    /// (SUPERBLOCK_COLORS - 1) cache lines per superblock. (The header
+    /// itself has to stay put: we find it by masking.)
+    static size_t colorOffset (const void * where, size_t sz) {
+      auto color = ((size_t) where / SuperblockSize) % SUPERBLOCK_COLORS;
+      auto offset = color * CACHE_LINE_SIZE;
+      // Never color away the only object.
+      return (offset + sz <= BufferSize) ? offset : 0;
+    }
     
+#if !HOARD_OUT_OF_LINE_METADATA
     /// The metadata.
     Header _header;
-
+#endif
     
-    /// The actual buffer. MUST immediately follow the header!
+    /// The actual buffer. MUST immediately follow the header (if any)!
     char _buf[BufferSize];
   };
 
@@ -25,7 +25,9 @@
 #endif
 
 #include "heaplayers.h"
+#include "hoardconstants.h"
 #include "../util/atomicfreelist.h"
+#include "../util/reciprocal.h"
 
 #include <cstdlib>
 
@@ -65,7 +67,7 @@ namespace Hoard {
   class HoardSuperblockHeaderHelper {
   public:
 
-    enum { Alignment = sizeof(void *) * 2 };
+    enum { Alignment = ObjectAlignment };
 
   public:
 
@@ -75,18 +77,20 @@ namespace Hoard {
       : _magicNumber (MAGIC_NUMBER ^ (size_t) this),
 	_objectSize (sz),
 	_objectSizeIsPowerOfTwo (!(sz & (sz - 1)) && sz),
+	_private (false),
 	_totalObjects ((unsigned int) (bufferSize / sz)),
+	_start (start),
 	_owner (nullptr),
-	_prev (nullptr),
-	_next (nullptr),
+	_objectSizeReciprocal (sz),
+	_position (start),
 	_reapableObjects (_totalObjects),
 	_objectsFree (_totalObjects),
-	_start (start),
-	_position (start)
+	_prev (nullptr),
+	_next (nullptr)
     {
       assert ((HL::align<Alignment>((size_t) start) == (size_t) start));
-      assert (_objectSize >= Alignment);
-      assert ((_totalObjects == 1) || (_objectSize % Alignment == 0));
+      assert (_objectSize >= MinObjectAlignment);
+      assert ((_totalObjects == 1) || (_objectSize % Alignment == 0) || (_objectSize == TinyObjectSize));
     }
 
     virtual ~HoardSuperblockHeaderHelper() {
@@ -97,21 +101,21 @@ namespace Hoard {
       assert (isValid());
       // Fast path: bump-pointer allocation from reapable region.
       void * ptr = reapAlloc();
-      assert ((ptr == nullptr) || ((size_t) ptr % Alignment == 0));
+      assert ((ptr == nullptr) || ((size_t) ptr % MinObjectAlignment == 0));
       if (HOARD_UNLIKELY(!ptr)) {
 	// Slow path: allocation from freelist (previously freed objects).
 	ptr = freeListAlloc();
-	assert ((ptr == nullptr) || ((size_t) ptr % Alignment == 0));
+	assert ((ptr == nullptr) || ((size_t) ptr % MinObjectAlignment == 0));
       }
       if (HOARD_LIKELY(ptr != nullptr)) {
 	assert (getSize(ptr) >= _objectSize);
-	assert ((size_t) ptr % Alignment == 0);
+	assert ((size_t) ptr % MinObjectAlignment == 0);
       }
       return ptr;
     }
 
     inline void free (void * ptr) {
-      assert ((size_t) ptr % Alignment == 0);
+      assert ((size_t) ptr % MinObjectAlignment == 0);
       assert (isValid());
       _freeList.insert (reinterpret_cast<FreeSLList::Entry *>(ptr));
       _objectsFree++;
@@ -137,14 +141,13 @@ namespace Hoard {
       void * p;
 
       // Optimization note: the modulo operation (%) is *really* slow on
-      // some architectures (notably x86-64). To reduce its overhead, we
-      // optimize for the case when the size request is a power of two,
-      // which is often enough to make a difference.
+      // some architectures (notably x86-64). Powers of two just need a
+      // mask; every other size uses a precomputed reciprocal.
 
       if (_objectSizeIsPowerOfTwo) {
 	p = (void *) ((size_t) ptr - (offset & (_objectSize - 1)));
       } else {
-	p = (void *) ((size_t) ptr - (offset % _objectSize));
+	p = (void *) ((size_t) ptr - _objectSizeReciprocal.remainder (offset));
       }
       return p;
     }
@@ -157,7 +160,7 @@ namespace Hoard {
       if (_objectSizeIsPowerOfTwo) {
 	newSize = _objectSize - (offset & (_objectSize - 1));
       } else {
-	newSize = _objectSize - (offset % _objectSize);
+	newSize = _objectSize - _objectSizeReciprocal.remainder (offset);
       }
       return newSize;
     }
@@ -166,6 +169,11 @@ namespace Hoard {
       return _objectSize;
     }
 
+    /// The address of the first object.
+    const char * getStart() const {
+      return _start;
+    }
+
     unsigned int getTotalObjects() const {
       return _totalObjects;
     }
@@ -174,6 +182,14 @@ namespace Hoard {
       return _objectsFree;
     }
 
+    bool isPrivate() const {
+      return _private;
+    }
+
+    void setPrivate (bool p) {
+      _private = p;
+    }
+
     /// Get current owner (atomic acquire for visibility).
     HeapType* getOwner() const {
       return _owner.load(std::memory_order_acquire);
@@ -235,7 +251,7 @@ namespace Hoard {
 	_position = ptr + _objectSize;
 	_reapableObjects--;
 	_objectsFree--;
-	assert ((size_t) ptr % Alignment == 0);
+	assert ((size_t) ptr % MinObjectAlignment == 0);
 	return ptr;
       } else {
 	return nullptr;
@@ -255,6 +271,13 @@ namespace Hoard {
 
     enum { MAGIC_NUMBER = 0xcafed00d };
 
+    // The fields below are grouped by who writes them, one cache line
+    // per group, so that remote frees never invalidate the line the
+    // owner allocates from (see the static_assert in HoardSuperblockHeader).
+
+    // ---- Read-mostly: written at construction (or on an ownership
+    // change) and read by every thread that frees into this superblock.
+
     /// A magic number used to verify validity of this header.
     const size_t _magicNumber;
 
@@ -264,38 +287,48 @@ namespace Hoard {
     /// True iff size is a power of two.
     const bool _objectSizeIsPowerOfTwo;
 
+    /// True while a private heap owns this superblock (see PrivateHeap).
+    bool _private;
+
     /// Total objects in the superblock.
     const unsigned int _totalObjects;
 
-    /// The lock.
-    LockType _theLock;
+    /// The start of reap allocation.
+    const char * _start;
 
     /// The owner of this superblock (atomic for lock-free ownership transfer).
     std::atomic<HeapType*> _owner;
 
-    /// The preceding superblock in a linked list.
-    BlockType* _prev;
+    /// For dividing by the object size (see normalize).
+    const Reciprocal _objectSizeReciprocal;
+
+    // ---- Owner-private: touched on every malloc and local free.
+
+    /// The cursor into the buffer following the header.
+    alignas(CACHE_LINE_SIZE) char * _position;
 
-    /// The succeeding superblock in a linked list.
-    BlockType* _next;
-    
     /// The number of objects available to be 'reap'ed.
     unsigned int _reapableObjects;
 
     /// The number of objects available for (re)use.
     unsigned int _objectsFree;
 
-    /// The start of reap allocation.
-    const char * _start;
-
-    /// The cursor into the buffer following the header.
-    char * _position;
-
     /// The list of freed objects.
     FreeSLList _freeList;
 
+    /// The preceding superblock in a linked list.
+    BlockType* _prev;
+
+    /// The succeeding superblock in a linked list.
+    BlockType* _next;
+
+    // ---- Remote-writable: other threads write here on every cross-thread free.
+
     /// Lock-free queue for delayed cross-thread frees (mimalloc-style optimization).
-    AtomicFreeList _delayedFreeList;
+    alignas(CACHE_LINE_SIZE) AtomicFreeList _delayedFreeList;
+
+    /// The lock.
+    LockType _theLock;
 
   public:
     // ========== Delayed Free Queue API (for cross-thread frees) ==========
@@ -348,7 +381,8 @@ namespace Hoard {
     }
   };
 
-  // A helper class that pads the header to the desired alignment.
+  // The header proper. The helper's cache-line-aligned groups already
+  // make its size a multiple of the alignment, so no padding is needed.
 
   template <class LockType,
 	    int SuperblockSize,
@@ -358,18 +392,24 @@ namespace Hoard {
   public:
 
     
-    HoardSuperblockHeader (size_t sz, size_t bufferSize)
-      : HoardSuperblockHeaderHelper<LockType,SuperblockSize,HeapType> (sz, bufferSize, (char *) (this + 1))
+    /// @param colorOffset Bytes to skip before the first object (see HoardSuperblock::colorOffset).
+    /// @param buffer      Where the objects go; by default, right after this header.
+    HoardSuperblockHeader (size_t sz, size_t bufferSize, size_t colorOffset = 0, char * buffer = nullptr)
+      : HoardSuperblockHeaderHelper<LockType,SuperblockSize,HeapType> (sz, bufferSize - colorOffset, (buffer ? buffer : (char *) (this + 1)) + colorOffset)
     {
       static_assert(sizeof(HoardSuperblockHeader) % Parent::Alignment == 0,
 		    "Superblock header size must be a multiple of the parent's alignment.");
+      // Read-mostly, owner-private and remote-writable fields each get
+      // exactly one cache line. If this fires, a group has outgrown its
+      // line (or lost its alignas) and remote frees will once again
+      // invalidate the owner's allocation state.
+      static_assert((alignof(Parent) == CACHE_LINE_SIZE) && (sizeof(Parent) == 3 * CACHE_LINE_SIZE),
+		    "Superblock header must be exactly three cache lines.");
     }
 
   private:
 
-    //    typedef Header_<LockType, SuperblockSize, HeapType> Header;
     typedef HoardSuperblockHeaderHelper<LockType,SuperblockSize,HeapType> Parent;
-    char _dummy[Parent::Alignment - (sizeof(Parent) % Parent::Alignment)];
   };
 
 }
@@ -27,6 +27,8 @@
 #include "hoardheap.h"
 #include "heapmanager.h"
 #include "tlab.h"
+#include "largeobjectcache.h"
+#include "reallochistory.h"
 #include "hoardconstants.h"
 
 #include "heaplayers.h"
@@ -53,7 +55,7 @@ namespace Hoard {
   //
   
   class HoardHeapType :
-    public HeapManager<TheLockType, HoardHeap<MaxThreads, NumHeaps> > {
+    public HeapManager<SiteLock<TheLockType, LockSite::HeapManager>, HoardHeap<MaxThreads, NumHeaps> > {
   };
   
   // Just an abbreviation.
@@ -65,18 +67,30 @@ namespace Hoard {
   // right.
   //
 
-  typedef ThreadLocalAllocationBuffer<HL::bins<TheHeader, SUPERBLOCK_SIZE>::NUM_BINS,
-				      HL::bins<TheHeader, SUPERBLOCK_SIZE>::getSizeClass,
-				      HL::bins<TheHeader, SUPERBLOCK_SIZE>::getClassSize,
+  // Each thread tracks 16 chains of growing reallocs, and promotes
+  // the second growth in a row onwards.
+
+  typedef ReallocHistory<16, 2> TheReallocHistory;
+
+  typedef ThreadLocalAllocationBuffer<SmallSizeClass<TheHeader, SUPERBLOCK_SIZE>::NUM_BINS,
+				      SmallSizeClass<TheHeader, SUPERBLOCK_SIZE>::getSizeClass,
+				      SmallSizeClass<TheHeader, SUPERBLOCK_SIZE>::getClassSize,
 				      LargestSmallObject,
 				      MAX_MEMORY_PER_TLAB,
 				      HoardHeapType::SuperblockType,
+				      BigSuperblockType,
 				      SUPERBLOCK_SIZE,
-				      HoardHeapType>
+				      HoardHeapType,
+				      LargeObjectCache<BigObjectSize + 1,
+						       MAX_LARGE_OBJECT_PER_TLAB,
+						       MAX_LARGE_MEMORY_PER_TLAB,
+						       MAX_LARGE_MEMORY_HANDOFF,
+						       HoardHeapType>,
+				      TheReallocHistory>
   TLABBase;
   
 }
 
-typedef HL::ANSIWrapper<Hoard::TLABBase> TheCustomHeapType;
+typedef Hoard::TinyANSIWrapper<Hoard::TLABBase> TheCustomHeapType;
 
 #endif
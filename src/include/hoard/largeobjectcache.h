@@ -0,0 +1,232 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_LARGEOBJECTCACHE_H
+#define HOARD_LARGEOBJECTCACHE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+
+#include "geometricsizeclass.h"
+#include "../util/atomicfreelist.h"
+
+namespace Hoard {
+
+  /**
+   * @class LargeObjectCache
+   * @brief A thread's cache of recently freed large objects.
+   *
+   * Holds up to CacheSize bytes of freed objects of MinSize to MaxSize
+   * bytes, binned by geometric size class, so that a thread reusing
+   * buffers of similar sizes does not touch the shared heaps or their
+   * locks. Once the cache is full, a thread that has been freeing more
+   * than it allocates puts freed objects on handoff lists shared by all
+   * threads (up to HandoffSize bytes in all), from which any thread that
+   * misses in its own cache takes them without a lock: when one thread
+   * allocates buffers and another frees them, they flow back that way.
+   * Anything else goes to ParentHeap, and a cache that keeps missing
+   * is flushed so that stale objects do not stay pinned.
+   *
+   * Every cached object remembers its usable size, and sits in the
+   * largest class that size covers, so every object in the class of a
+   * request fits it.
+   */
+
+  template <size_t MinSize,
+	    size_t MaxSize,
+	    size_t CacheSize,
+	    size_t HandoffSize,
+	    class ParentHeap>
+  class LargeObjectCache {
+  public:
+
+    LargeObjectCache (ParentHeap * parent)
+      : _parentHeap (parent),
+	_cachedBytes (0),
+	_netFreed (0),
+	_rejectedBytes (0),
+	_bins ()
+    {}
+
+    /// An object of at least sz bytes, or null if none is cached.
+    inline void * malloc (size_t sz) {
+      if ((sz < MinSize) || (sz > MaxSize)) {
+	return nullptr;
+      }
+      account (-1);
+      auto c = SizeClass::size2class (sz);
+      auto i = c - MinClass;
+      // The class below may hold objects that are big enough, and
+      // that fit more tightly than any in the class of the request.
+      auto * b = _bins[i - 1];
+      if ((b != nullptr) && (b->size >= sz)) {
+	i--;
+      } else {
+	b = _bins[i];
+	if (b == nullptr) {
+	  return takeHandoff (c);
+	}
+      }
+      _bins[i] = next (b);
+      _cachedBytes -= b->size;
+      return b;
+    }
+
+    /// Cache an object of sz bytes; false if it should go to the parent.
+    inline bool free (void * ptr, size_t sz) {
+      if ((sz < MinSize) || (sz > MaxSize)) {
+	return false;
+      }
+      account (1);
+      auto c = classOf (sz);
+      auto * b = reinterpret_cast<Block *>(ptr);
+      b->size = sz;
+      if (_cachedBytes + sz <= CacheSize) {
+	b->next.store (_bins[c - MinClass], std::memory_order_relaxed);
+	_bins[c - MinClass] = b;
+	_cachedBytes += sz;
+	return true;
+      }
+      // Hand it to other threads, if this one is not allocating as
+      // much as it frees and the handoff lists have room.
+      if (_netFreed <= NetFreer) {
+	// Once a cache's worth has gone past it, what the cache holds
+	// is not being reused: flush it, rather than pin it in the
+	// parent's memory, and start over.
+	_rejectedBytes += sz;
+	if (_rejectedBytes > CacheSize) {
+	  clear();
+	}
+	return false;
+      }
+      if (handoffBytes().fetch_add (sz, std::memory_order_relaxed) + sz <= HandoffSize) {
+	handoff (c).push (b);
+	return true;
+      }
+      handoffBytes().fetch_sub (sz, std::memory_order_relaxed);
+      return false;
+    }
+
+    /// Return every cached object to the parent.
+    void clear() {
+      for (int c = 0; c < NumClasses; c++) {
+	while (auto * b = _bins[c]) {
+	  _bins[c] = next (b);
+	  _cachedBytes -= b->size;
+	  _parentHeap->free (b);
+	}
+      }
+      assert (_cachedBytes == 0);
+      _rejectedBytes = 0;
+    }
+
+  private:
+
+    typedef GeometricSizeClass<20> SizeClass;
+
+    /// A cached object's first bytes.
+    struct Block : AtomicFreeList::Entry {
+      size_t size;
+    };
+
+    /// The largest class that sz covers.
+    static inline int classOf (size_t sz) {
+      auto c = SizeClass::size2class (sz);
+      return (SizeClass::class2size (c) > sz) ? c - 1 : c;
+    }
+
+    /// The lowest bin holds objects of MinClass; requests of MinSize
+    /// bytes also look one class down.
+    enum { MinClass = SizeClass::size2class (MinSize) - 1 };
+    enum { NumClasses = SizeClass::size2class (MaxSize) - MinClass + 1 };
+
+    /// A thread has been freeing more than it allocates once it has
+    /// freed this many more objects than it requested.
+    enum { NetFreer = CacheSize / MinSize };
+
+    /// Track the objects freed less the objects requested, within
+    /// bounds so that a change of pattern shows up quickly.
+    inline void account (int n) {
+      _netFreed += n;
+      if (_netFreed > 2 * NetFreer) {
+	_netFreed = 2 * NetFreer;
+      } else if (_netFreed < -2 * NetFreer) {
+	_netFreed = -2 * NetFreer;
+      }
+    }
+
+    static inline Block * next (Block * b) {
+      return static_cast<Block *>(b->next.load (std::memory_order_relaxed));
+    }
+
+    /// Take everything handed off in class c: return one object, keep
+    /// what fits in this cache, and hand the rest back.
+    void * takeHandoff (int c) {
+      if (handoff (c).isEmpty()) {
+	return nullptr;
+      }
+      auto * b = static_cast<Block *>(handoff (c).popAll());
+      if (b == nullptr) {
+	return nullptr;
+      }
+      size_t taken = b->size;
+      for (auto * r = next (b); r != nullptr; ) {
+	auto * n = next (r);
+	if (_cachedBytes + r->size <= CacheSize) {
+	  r->next.store (_bins[c - MinClass], std::memory_order_relaxed);
+	  _bins[c - MinClass] = r;
+	  _cachedBytes += r->size;
+	  taken += r->size;
+	} else {
+	  handoff (c).push (r);
+	}
+	r = n;
+      }
+      handoffBytes().fetch_sub (taken, std::memory_order_relaxed);
+      return b;
+    }
+
+    /// The handoff lists, shared by every thread. Any number of threads
+    /// may take from them, since popAll takes a whole list at once.
+    static inline AtomicFreeList& handoff (int c) {
+      static AtomicFreeList theLists[NumClasses];
+      return theLists[c - MinClass];
+    }
+
+    static inline std::atomic<size_t>& handoffBytes() {
+      static std::atomic<size_t> theBytes { 0 };
+      return theBytes;
+    }
+
+    /// Where objects go when they are not cached.
+    ParentHeap * _parentHeap;
+
+    /// The bytes held in this cache.
+    size_t _cachedBytes;
+
+    /// The objects freed here less the objects requested, recently.
+    int _netFreed;
+
+    /// The bytes not cached, since the cache last emptied.
+    size_t _rejectedBytes;
+
+    /// The cached objects, by class.
+    Block * _bins[NumClasses];
+  };
+
+}
+
+#endif
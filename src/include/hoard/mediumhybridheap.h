@@ -0,0 +1,77 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_MEDIUMHYBRIDHEAP_H
+#define HOARD_MEDIUMHYBRIDHEAP_H
+
+#include <cstddef>
+
+namespace Hoard {
+
+  /**
+   * @class MediumHybridHeap
+   * @brief Sends requests between BigSize and MediumSize bytes to Medium.
+   *
+   * Medium objects live in span arenas rather than behind superblock
+   * headers, so frees and size queries are routed by address (through
+   * Spans, the arenas' SpanHeap type) before SuperHeap looks for a
+   * superblock. Interior pointers, e.g. from memalign, are accepted.
+   */
+
+  template <size_t BigSize,
+	    size_t MediumSize,
+	    class Spans,
+	    class Medium,
+	    class SuperHeap>
+  class MediumHybridHeap : public SuperHeap {
+  public:
+
+    static_assert(BigSize < MediumSize,
+		  "Medium objects must be larger than the largest small object.");
+
+    inline void * malloc (size_t sz) {
+      if ((sz > BigSize) && (sz <= MediumSize)) {
+	return _medium.malloc (sz);
+      }
+      return SuperHeap::malloc (sz);
+    }
+
+    inline void free (void * ptr) {
+      if (Spans::isSpan (ptr)) {
+	auto * start = Spans::span (ptr);
+	if (start != nullptr) {
+	  _medium.free (start);
+	}
+	// else: not a live span, so drop it.
+	return;
+      }
+      SuperHeap::free (ptr);
+    }
+
+    inline size_t getSize (void * ptr) {
+      if (Spans::isSpan (ptr)) {
+	return Spans::getSize (ptr);
+      }
+      return SuperHeap::getSize (ptr);
+    }
+
+  private:
+
+    Medium _medium;
+  };
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_PRIVATEHEAP_H
+#define HOARD_PRIVATEHEAP_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "hoardmanager.h"
+#include "privatesuperblockmap.h"
+
+namespace Hoard {
+
+  /**
+   * @class PrivateHeapParent
+   * @brief Where a PrivateHeap gets its superblocks, and where they go back.
+   *
+   * Superblocks come from the global heap, but only empty ones: a
+   * superblock with objects in use may have some of them sitting in a
+   * thread's local heap, where clearing it would leave them dangling.
+   * Failing that, they come fresh from the source. Every superblock
+   * handed out is marked private, in its header and in
+   * PrivateSuperblockMap, until it is put back.
+   */
+
+  template <class GlobalHeapType,
+	    class SourceHeap,
+	    class SuperblockType_,
+	    size_t SuperblockSize>
+  class PrivateHeapParent {
+  public:
+
+    typedef SuperblockType_ SuperblockType;
+
+    SuperblockType * get (size_t sz, void * dest) {
+      auto * s = reinterpret_cast<SuperblockType *>(_global.getEmpty (sz, dest));
+      if (!s) {
+	void * ptr = _source.malloc (SuperblockSize);
+	if (!ptr) {
+	  return nullptr;
+	}
+	s = new (ptr) SuperblockType (sz);
+      }
+      if (!PrivateSuperblockMap<SuperblockSize>::set (s)) {
+	_global.put (s, sz);
+	return nullptr;
+      }
+      s->setPrivate (true);
+      return s;
+    }
+
+    void put (SuperblockType * s, size_t sz) {
+      s->setPrivate (false);
+      PrivateSuperblockMap<SuperblockSize>::clear (s);
+      _global.put (s, sz);
+    }
+
+  private:
+
+    GlobalHeapType _global;
+    SourceHeap _source;
+  };
+
+
+  class privateThresholdFunctionClass {
+  public:
+    inline static bool function (uint64_t, uint64_t, size_t) {
+      // Superblocks stay until destroy.
+      return false;
+    }
+  };
+
+  // HoardManager only turns to its source when the parent has
+  // nothing, and the parent never runs dry short of memory.
+  class NoSuperblockSource {
+  public:
+    inline void * malloc (size_t) {
+      return nullptr;
+    }
+  };
+
+  /**
+   * @class PrivateHeap
+   * @brief A heap of small objects that can all be freed at once.
+   *
+   * Manager is a (locked) HoardManager that keeps every superblock it
+   * gets, since it never crosses the emptiness threshold, until
+   * destroy empties them and gives them back to the global heap.
+   * Objects come from a cache for each size class, refilled a batch at
+   * a time, so one thread at a time may allocate. Any thread may free
+   * objects one at a time: free() sends them to their superblock's
+   * delayed-free queue, as for any superblock owned by another heap.
+   */
+
+  template <class Manager>
+  class PrivateHeap : public Manager {
+  public:
+
+    ~PrivateHeap() {
+      destroy();
+    }
+
+    MALLOC_FUNCTION INLINE void * malloc (size_t sz) {
+      const auto c = binType::getSizeClass (sz);
+      void * ptr = _cache(c).get();
+      if (ptr == nullptr) {
+	ptr = refill (c);
+      }
+      return ptr;
+    }
+
+    /// Free everything allocated here.
+    void destroy() {
+      for (int c = 0; c < NumBins; c++) {
+	_cache(c).clear();
+      }
+      Manager::releaseAll();
+    }
+
+  private:
+
+    typedef typename Manager::SuperblockType SuperblockType;
+    typedef SmallSizeClass<typename SuperblockType::Header, sizeof(SuperblockType)> binType;
+
+    enum { NumBins = binType::NUM_BINS };
+
+    /// About how many bytes to take from the manager at once.
+    static constexpr size_t RefillBytes = 8192;
+
+    static constexpr size_t MaxRefill = 64;
+
+    NO_INLINE void * refill (int c) {
+      const auto sz = binType::getClassSize (c);
+      size_t n = RefillBytes / sz;
+      if (n < 1) {
+	n = 1;
+      }
+      if (n > MaxRefill) {
+	n = MaxRefill;
+      }
+      void * ptrs[MaxRefill];
+      auto got = Manager::mallocBatch (sz, n, ptrs);
+      if (got == 0) {
+	return nullptr;
+      }
+      // The cache hands objects out last in, first out, so push them
+      // in reverse: later mallocs then get ptrs[1], ptrs[2], ... in
+      // the order mallocBatch took them (by address, from a fresh
+      // superblock), and objects allocated together sit together.
+      for (size_t i = got - 1; i > 0; i--) {
+	_cache(c).insert (reinterpret_cast<HL::SLList::Entry *>(ptrs[i]));
+      }
+      return ptrs[0];
+    }
+
+    /// Objects taken from the manager but not yet handed out.
+    Array<NumBins, HL::SLList> _cache;
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_PRIVATESUPERBLOCKMAP_H
+#define HOARD_PRIVATESUPERBLOCKMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "heaplayers.h"
+
+namespace Hoard {
+
+  /**
+   * @class PrivateSuperblockMap
+   * @brief One bit per superblock, set while a private heap owns it.
+   *
+   * This duplicates the private flag in each superblock's header, so
+   * that the TLAB's sized free can keep private objects out of its
+   * local heap without touching the (likely cold) header. A word of
+   * bits covers 64 neighboring superblocks, so lookups mostly hit in
+   * cache.
+   *
+   * Bits are indexed by superblock number (address / SuperblockSize)
+   * through a two-level radix table, like SuperblockMetadataTable.
+   * Leaves are created when a superblock in their range first goes
+   * private, and never released.
+   */
+  template <size_t SuperblockSize>
+  class PrivateSuperblockMap {
+  public:
+
+    /// True if the superblock holding ptr may belong to a private heap.
+    /// Addresses the table does not cover always answer true.
+    static inline bool contains (const void * ptr) {
+      auto n = number (ptr);
+      if (n >> NumberBits) {
+	return true;
+      }
+      // Relaxed is enough: whoever frees an object got it (through the
+      // application's own synchronization) after its superblock was
+      // marked.
+      auto * leaf = root()[n >> LeafBits].load (std::memory_order_relaxed);
+      if (leaf == nullptr) {
+	return false;
+      }
+      auto i = n & (LeafBitCount - 1);
+      return (leaf[i / WordBits].load (std::memory_order_relaxed) >> (i % WordBits)) & 1;
+    }
+
+    /// Mark the superblock at sb as private. Returns false if its leaf
+    /// could not be created, in which case it must not go private.
+    static bool set (const void * sb) {
+      auto n = number (sb);
+      if (n >> NumberBits) {
+	// Always reported as private anyway.
+	return true;
+      }
+      auto * leaf = getLeaf (n);
+      if (leaf == nullptr) {
+	return false;
+      }
+      auto i = n & (LeafBitCount - 1);
+      leaf[i / WordBits].fetch_or ((uint64_t) 1 << (i % WordBits), std::memory_order_relaxed);
+      return true;
+    }
+
+    /// Mark the superblock at sb as no longer private.
+    static void clear (const void * sb) {
+      auto n = number (sb);
+      if (n >> NumberBits) {
+	return;
+      }
+      auto * leaf = root()[n >> LeafBits].load (std::memory_order_acquire);
+      if (leaf == nullptr) {
+	return;
+      }
+      auto i = n & (LeafBitCount - 1);
+      leaf[i / WordBits].fetch_and (~((uint64_t) 1 << (i % WordBits)), std::memory_order_relaxed);
+    }
+
+  private:
+
+    typedef std::atomic<uint64_t> Word;
+
+    static constexpr int log2 (size_t v) {
+      return (v <= 1) ? 0 : 1 + log2 (v >> 1);
+    }
+
+    static_assert((SuperblockSize & (SuperblockSize - 1)) == 0,
+		  "Superblock size must be a power of two.");
+
+    /// User-space addresses we cover (x86-64 and AArch64 both use 48).
+    static constexpr int AddressBits = 48;
+
+    static constexpr int NumberBits = AddressBits - log2 (SuperblockSize);
+
+    static constexpr int WordBits = 64;
+
+    /// 2^18 bits (32K) per leaf: 64GB of 256K superblocks per leaf.
+    static constexpr int LeafBits = (NumberBits < 18) ? NumberBits : 18;
+    static constexpr int RootBits = NumberBits - LeafBits;
+    static constexpr size_t LeafBitCount = (size_t) 1 << LeafBits;
+    static constexpr size_t LeafBytes = (LeafBitCount + WordBits - 1) / WordBits * sizeof(Word);
+
+    static inline size_t number (const void * sb) {
+      return (size_t) sb >> log2 (SuperblockSize);
+    }
+
+    static Word * getLeaf (size_t n) {
+      auto& entry = root()[n >> LeafBits];
+      auto * leaf = entry.load (std::memory_order_acquire);
+      if (leaf) {
+	return leaf;
+      }
+      leaf = reinterpret_cast<Word *>(HL::MmapWrapper::map (LeafBytes));
+      if (leaf == nullptr) {
+	return nullptr;
+      }
+      Word * expected = nullptr;
+      if (!entry.compare_exchange_strong (expected, leaf,
+					  std::memory_order_acq_rel,
+					  std::memory_order_acquire)) {
+	// Someone else installed this leaf first.
+	HL::MmapWrapper::unmap (leaf, LeafBytes);
+	leaf = expected;
+      }
+      return leaf;
+    }
+
+    static inline std::atomic<Word *> * root() {
+      // Zero-initialized static storage; pages are only touched as
+      // leaves get installed.
+      static std::atomic<Word *> theRoot[1 << RootBits];
+      return theRoot;
+    }
+  };
+
+}
+
+#endif
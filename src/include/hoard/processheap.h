@@ -33,21 +33,24 @@ namespace Hoard {
 	    int EmptinessClasses,
 	    class LockType,
 	    class ThresholdClass,
-	    class MmapSource>
+	    class MmapSource,
+	    class HeapLockType = LockType,
+	    class BinLockType = HeapLockType>
   class ProcessHeap :
     public ConformantHeap<
     HoardManager<AlignedSuperblockHeap<LockType, SuperblockSize, MmapSource>,
 		 EmptyHoardManager<HoardSuperblock<LockType,
 						   SuperblockSize,
-						   ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, ThresholdClass, MmapSource>,
+						   ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, ThresholdClass, MmapSource, HeapLockType, BinLockType>,
 						   Header_>>,
 		 HoardSuperblock<LockType,
 				 SuperblockSize,
-				 ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, ThresholdClass, MmapSource>, Header_>,
+				 ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, ThresholdClass, MmapSource, HeapLockType, BinLockType>, Header_>,
 		 EmptinessClasses,
-		 LockType,
+		 HeapLockType,
 		 ThresholdClass,
-		 ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, ThresholdClass, MmapSource> > > {
+		 ProcessHeap<SuperblockSize, Header_, EmptinessClasses, LockType, ThresholdClass, MmapSource, HeapLockType, BinLockType>,
+		 BinLockType> > {
   
   public:
   
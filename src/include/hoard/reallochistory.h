@@ -0,0 +1,120 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_REALLOCHISTORY_H
+#define HOARD_REALLOCHISTORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Hoard {
+
+  /**
+   * @class ReallocHistory
+   * @brief A thread's record of objects that realloc keeps growing.
+   *
+   * Code that grows a buffer a little at a time (realloc(p, n + k))
+   * pays for a copy each time it outgrows its size class. Once an
+   * object has been grown MinGrowths times in a row, the next growth
+   * asks for half again as much as requested, so a chain of growths
+   * copies only logarithmically often in the final size, and never
+   * wastes more than a third of what it holds.
+   *
+   * The record is a small direct-mapped table from the last object of
+   * each chain (its address and usable size) to the chain's length; a
+   * collision just forgets a chain. An object freed outright leaves its
+   * entry behind, so a new object at that address continues the chain
+   * only if its size matches too. Every thread updates the shared
+   * counters (see hoard_realloc_stats) only when realloc needs a new
+   * object anyway, or has resized a big one (which takes BigHeap's
+   * lock).
+   */
+
+  template <int NumEntries, int MinGrowths>
+  class ReallocHistory {
+  public:
+
+    struct Statistics {
+      std::atomic<uint64_t> grown { 0 };
+      std::atomic<uint64_t> resized { 0 };
+      std::atomic<uint64_t> promoted { 0 };
+      std::atomic<uint64_t> headroomBytes { 0 };
+    };
+
+    ReallocHistory()
+      : _entries ()
+    {}
+
+    /// How many times in a row the object at ptr, of sz usable bytes,
+    /// has grown, forgetting it.
+    inline int take (void * ptr, size_t sz) {
+      auto& e = _entries[index (ptr)];
+      if ((e.ptr != ptr) || (e.size != sz)) {
+	return 0;
+      }
+      e.ptr = nullptr;
+      return e.growths;
+    }
+
+    /// Remember that the object at ptr, of sz usable bytes, has grown
+    /// growths times in a row.
+    inline void put (void * ptr, size_t sz, int growths) {
+      auto& e = _entries[index (ptr)];
+      e.ptr = ptr;
+      e.size = sz;
+      e.growths = growths;
+    }
+
+    /// The size to ask for when an object grows to sz bytes for the
+    /// growths-th time in a row, up to limit bytes.
+    static inline size_t request (size_t sz, int growths, size_t limit) {
+      if ((growths < MinGrowths) || (sz >= limit)) {
+	return sz;
+      }
+      size_t promoted = sz + sz / 2;
+      if (promoted > limit) {
+	promoted = limit;
+      }
+      auto& s = stats();
+      s.promoted.fetch_add (1, std::memory_order_relaxed);
+      s.headroomBytes.fetch_add (promoted - sz, std::memory_order_relaxed);
+      return promoted;
+    }
+
+    static Statistics& stats() {
+      static Statistics theStats;
+      return theStats;
+    }
+
+  private:
+
+    struct Entry {
+      void * ptr;
+      size_t size;
+      int growths;
+    };
+
+    static inline unsigned int index (void * ptr) {
+      auto p = reinterpret_cast<uintptr_t>(ptr);
+      return (unsigned int) ((p >> 4) ^ (p >> 16)) % NumEntries;
+    }
+
+    Entry _entries[NumEntries];
+  };
+
+}
+
+#endif
@@ -17,6 +17,8 @@
 #define HOARD_REDIRECTFREE_H
 
 #include "heaplayers.h"
+#include "hoardconstants.h"
+#include "threadtoken.h"
 
 // Branch prediction hints (mimalloc-style optimization)
 #if defined(__GNUC__) || defined(__clang__)
@@ -51,10 +53,33 @@ namespace Hoard {
     inline void * malloc (size_t sz) {
       void * ptr = _theHeap.malloc (sz);
       assert (getSize(ptr) >= sz);
-      assert ((size_t) ptr % Alignment == 0);
+      assert ((size_t) ptr % MinObjectAlignment == 0);
       return ptr;
     }
 
+    /// Malloc for the exclusive owner (passthrough, no locks).
+    inline void * unlockedMalloc (size_t sz) {
+      return _theHeap.unlockedMalloc (sz);
+    }
+
+    /// Locked malloc that backs off if the heap became exclusive (passthrough).
+    inline bool tryMalloc (size_t sz, void *& ptr) {
+      return _theHeap.tryMalloc (sz, ptr);
+    }
+
+    /// Batch versions of the above (passthrough).
+    inline size_t mallocBatch (size_t sz, size_t n, void ** ptrs) {
+      return _theHeap.mallocBatch (sz, n, ptrs);
+    }
+
+    inline size_t unlockedMallocBatch (size_t sz, size_t n, void ** ptrs) {
+      return _theHeap.unlockedMallocBatch (sz, n, ptrs);
+    }
+
+    inline bool tryMallocBatch (size_t sz, size_t n, void ** ptrs, size_t& got) {
+      return _theHeap.tryMallocBatch (sz, n, ptrs, got);
+    }
+
     size_t getSize (void * ptr) {
       return Heap::getSize (ptr);
     }
@@ -79,6 +104,26 @@ namespace Hoard {
       _theHeap.setActive(active);
     }
 
+    /// Get the exclusive owner's thread token, or 0 (passthrough).
+    ThreadToken getOwnerThreadId() const {
+      return _theHeap.getOwnerThreadId();
+    }
+
+    /// Set the exclusive owner's thread token, or 0 (passthrough).
+    void setOwnerThreadId(ThreadToken tid) {
+      _theHeap.setOwnerThreadId(tid);
+    }
+
+    /// Lock the underlying heap (passthrough).
+    void lock() {
+      _theHeap.lock();
+    }
+
+    /// Unlock the underlying heap (passthrough).
+    void unlock() {
+      _theHeap.unlock();
+    }
+
     /// Free the given object using delayed queue for cross-thread frees.
     ///
     /// This implements mimalloc-style delayed frees:
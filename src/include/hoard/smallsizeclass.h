@@ -0,0 +1,243 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_SMALLSIZECLASS_H
+#define HOARD_SMALLSIZECLASS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "heaplayers.h"
+#include "hoardconstants.h"
+
+// Build with -DHOARD_SIZE_CLASS_TABLE='"file.h"' to take the size
+// classes from a header generated by src/tools/sizeclass-gen.
+#if defined(HOARD_SIZE_CLASS_TABLE)
+#include HOARD_SIZE_CLASS_TABLE
+#endif
+
+namespace Hoard {
+
+  /// The size classes for objects held in superblocks, in increasing
+  /// order: every multiple of Alignment up to LargestSmall, then
+  /// classes growing by at most MaxOverhead percent up to BigObject.
+  template <size_t LargestSmall, size_t BigObject, size_t Alignment, size_t MaxOverhead>
+  class SmallSizeClassSizes {
+  public:
+
+    static constexpr int count() {
+      int n = 0;
+      size_t sz = 0;
+      while (sz < BigObject) {
+	sz = next (sz);
+	n++;
+      }
+      return n;
+    }
+
+    static constexpr size_t largest() {
+      return BigObject;
+    }
+
+    /// The class size after sz.
+    static constexpr size_t next (size_t sz) {
+      size_t n = 0;
+      if (sz < LargestSmall) {
+	n = sz - (sz % Alignment) + Alignment;
+      } else {
+	n = sz + (sz * MaxOverhead) / 100;
+	n = n - (n % Alignment);
+	if (n <= sz) {
+	  n = sz + Alignment;
+	}
+      }
+      return (n < BigObject) ? n : BigObject;
+    }
+  };
+
+#if defined(HOARD_SIZE_CLASS_TABLE)
+  /// The size classes in generatedSizeClasses, in the same form.
+  class GeneratedSizeClassSizes {
+  public:
+
+    static constexpr int count() {
+      return (int) (sizeof(generatedSizeClasses) / sizeof(generatedSizeClasses[0]));
+    }
+
+    static constexpr size_t largest() {
+      return generatedSizeClasses[count() - 1];
+    }
+
+    static constexpr size_t next (size_t sz) {
+      for (int c = 0; c < count(); c++) {
+	if (generatedSizeClasses[c] > sz) {
+	  return generatedSizeClasses[c];
+	}
+      }
+      return largest();
+    }
+  };
+#endif
+
+  /// Sizes, preceded by a class of Tiny bytes unless Tiny is 0.
+  template <class Sizes, size_t Tiny>
+  class TinySizeClassSizes {
+  public:
+
+    static constexpr int count() {
+      return Sizes::count() + (Tiny ? 1 : 0);
+    }
+
+    static constexpr size_t largest() {
+      return Sizes::largest();
+    }
+
+    static constexpr size_t next (size_t sz) {
+      return (sz < Tiny) ? Tiny : Sizes::next (sz);
+    }
+  };
+
+  /// The tables behind SmallSizeClass, built at compile time.
+  template <class Sizes, size_t LargestSmall, size_t Granularity>
+  struct SmallSizeClassTables {
+
+    enum { NumClasses = Sizes::count() };
+
+    /// The size of each class.
+    size_t classSize[NumClasses];
+
+    /// The class for each size up to LargestSmall, indexed by
+    /// (size + Granularity - 1) / Granularity.
+    uint8_t smallClass[LargestSmall / Granularity + 1];
+
+    constexpr SmallSizeClassTables()
+      : classSize(),
+	smallClass()
+    {
+      static_assert(NumClasses <= 256,
+		    "Small size classes must fit in a byte.");
+      size_t sz = 0;
+      for (int c = 0; c < NumClasses; c++) {
+	sz = Sizes::next (sz);
+	classSize[c] = sz;
+      }
+      int c = 0;
+      for (size_t i = 0; i <= LargestSmall / Granularity; i++) {
+	while (classSize[c] < i * Granularity) {
+	  c++;
+	}
+	smallClass[i] = (uint8_t) c;
+      }
+    }
+  };
+
+  /**
+   * @class SmallSizeClass
+   * @brief Maps object sizes to superblock size classes and back.
+   *
+   * A replacement for HL::bins that keeps its interface (NUM_BINS,
+   * BIG_OBJECT, getSizeClass, getClassSize) and its split between
+   * small and big objects, but computes everything at compile time.
+   * Sizes up to LargestSmallObject (everything the TLABs cache) map
+   * to a class with a single table lookup; larger ones do a binary
+   * search over the remaining classes.
+   */
+  template <class Header, size_t SuperblockSize>
+  class SmallSizeClass {
+  public:
+
+    enum { Alignment = Header::Alignment };
+
+  private:
+
+    /// The most we could put in superblocks.
+    enum { MaxBigObject = ((size_t) HL::bins<Header, SuperblockSize>::BIG_OBJECT / Alignment) * Alignment };
+
+#if defined(HOARD_SIZE_CLASS_TABLE)
+    typedef GeneratedSizeClassSizes Sizes;
+    static_assert(Sizes::largest() <= MaxBigObject,
+		  "Generated size classes must fit in superblocks.");
+    static_assert(Sizes::largest() >= LargestSmallObject,
+		  "Generated size classes must cover every small object.");
+#else
+    /// Percent internal fragmentation for classes above LargestSmallObject.
+    enum { MaxOverhead = 20 };
+
+    typedef SmallSizeClassSizes<LargestSmallObject, MaxBigObject, Alignment, MaxOverhead> Sizes;
+#endif
+
+    /// The tiny class, if any, needs a finer-grained lookup table.
+    static constexpr size_t Granularity = (TinyObjectSize != 0) ? (size_t) TinyObjectSize : (size_t) Alignment;
+
+    typedef SmallSizeClassTables<TinySizeClassSizes<Sizes, TinyObjectSize>,
+				 LargestSmallObject, Granularity> Tables;
+
+    static constexpr Tables theTables {};
+
+  public:
+
+    /// Objects larger than this do not go in superblocks.
+    enum { BIG_OBJECT = Sizes::largest() };
+
+    enum { NUM_BINS = Tables::NumClasses };
+
+    static constexpr inline int getSizeClass (size_t sz) {
+      if (sz <= LargestSmallObject) {
+	return theTables.smallClass[(sz + Granularity - 1) / Granularity];
+      }
+      // Binary search among the larger classes (LargestSmallObject
+      // need not be a class boundary).
+      int left = theTables.smallClass[LargestSmallObject / Granularity];
+      int right = NUM_BINS - 1;
+      while (left < right) {
+	int mid = (left + right) / 2;
+	if (theTables.classSize[mid] < sz) {
+	  left = mid + 1;
+	} else {
+	  right = mid;
+	}
+      }
+      return left;
+    }
+
+    static constexpr inline size_t getClassSize (int cl) {
+      return theTables.classSize[cl];
+    }
+
+    /// Verify that this class is working properly: every size maps to
+    /// the smallest class that holds it.
+    static constexpr bool test() {
+      for (int c = 0; c < NUM_BINS; c++) {
+	auto sz = getClassSize (c);
+	if (((sz % Alignment != 0) && (sz != TinyObjectSize)) || (getSizeClass (sz) != c)) {
+	  return false;
+	}
+	if ((c > 0) && ((sz <= getClassSize (c - 1)) || (getSizeClass (getClassSize (c - 1) + 1) != c))) {
+	  return false;
+	}
+      }
+      return (getSizeClass (0) == 0) && (getClassSize (NUM_BINS - 1) == BIG_OBJECT);
+    }
+  };
+
+  // Lookups index the tables at run time, which needs a definition
+  // before C++17 (where constexpr static members became inline).
+  template <class Header, size_t SuperblockSize>
+  constexpr typename SmallSizeClass<Header, SuperblockSize>::Tables
+  SmallSizeClass<Header, SuperblockSize>::theTables;
+
+}
+
+#endif
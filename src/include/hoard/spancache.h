@@ -0,0 +1,88 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_SPANCACHE_H
+#define HOARD_SPANCACHE_H
+
+#include <cstddef>
+
+#include "heaplayers.h"
+#include "array.h"
+
+namespace Hoard {
+
+  /**
+   * @class SpanCache
+   * @brief Holds up to CacheSize bytes of freed spans for reuse.
+   *
+   * Spans of at most MaxCachedSize bytes are kept on one list per page
+   * count, so a request for the same number of pages is served without
+   * touching SuperHeap (and its lock). Spans is the SpanHeap type that
+   * answers size queries; freed pointers must be span starts.
+   */
+
+  template <size_t CacheSize,
+	    size_t MaxCachedSize,
+	    class Spans,
+	    class SuperHeap>
+  class SpanCache : public SuperHeap {
+  public:
+
+    enum { Alignment = Spans::Alignment };
+
+    SpanCache()
+      : _cachedBytes (0)
+    {}
+
+    inline void * malloc (size_t sz) {
+      auto pages = (sz + Spans::Alignment - 1) / Spans::Alignment;
+      if ((pages > 0) && (pages <= MaxCachedPages)) {
+	auto * ptr = _cache((int) (pages - 1)).get();
+	if (ptr != nullptr) {
+	  _cachedBytes -= pages * Spans::Alignment;
+	  return ptr;
+	}
+      }
+      return SuperHeap::malloc (sz);
+    }
+
+    inline void free (void * ptr) {
+      auto sz = Spans::getSize (ptr);
+      if ((sz <= MaxCachedSize) && (_cachedBytes + sz <= CacheSize)) {
+	_cache((int) (sz / Spans::Alignment - 1)).insert (reinterpret_cast<HL::SLList::Entry *>(ptr));
+	_cachedBytes += sz;
+	return;
+      }
+      SuperHeap::free (ptr);
+    }
+
+    inline static size_t getSize (void * ptr) {
+      return Spans::getSize (ptr);
+    }
+
+  private:
+
+    enum { MaxCachedPages = MaxCachedSize / Spans::Alignment };
+
+    /// The bytes in cached spans.
+    size_t _cachedBytes;
+
+    /// The cached spans, by page count.
+    Array<MaxCachedPages, HL::SLList> _cache;
+  };
+
+}
+
+#endif
@@ -0,0 +1,473 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_SPANHEAP_H
+#define HOARD_SPANHEAP_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "heaplayers.h"
+#include "alignedmmap.h"
+
+namespace Hoard {
+
+  /**
+   * @class SpanHeap
+   * @brief Page-multiple spans carved out of large, aligned arenas.
+   *
+   * Each arena starts with a map holding a tag for every page, so any
+   * pointer into a span finds the span, its size, and its neighbours
+   * without a header in front of the object. Free spans coalesce with
+   * free neighbours and wait in bins by page count; a request takes the
+   * first span that fits and splits off the rest.
+   *
+   * Memory only goes back to the OS through purge(): once the free
+   * pages that may still be resident ("dirty") exceed RetainFraction
+   * percent of the pages in use, and RetainSlop bytes, dirty spans are
+   * released (on Linux, with MADV_DONTNEED, so they read back as zero),
+   * largest first, until half that much is left; arenas that are
+   * entirely free are unmapped instead.
+   *
+   * Not thread-safe: wrap it in a LockedHeap. The static queries
+   * (isSpan, span, getSize) take no lock; they are only valid for
+   * spans the caller owns.
+   */
+
+  template <size_t ArenaSize,
+	    size_t PageSize,
+	    int RetainFraction,
+	    size_t RetainSlop>
+  class SpanHeap {
+  public:
+
+    enum { Alignment = PageSize };
+
+    SpanHeap()
+      : _arenas (nullptr),
+	_inUsePages (0),
+	_dirtyPages (0),
+	_nonEmpty ()
+    {
+      static_assert((ArenaSize & (ArenaSize - 1)) == 0,
+		    "Arenas must be a power of two in size.");
+      static_assert(ArenaSize % PageSize == 0,
+		    "Arenas must hold a whole number of pages.");
+      static_assert(NumPages >= 128,
+		    "Arenas must hold at least 128 pages.");
+      static_assert(NumPages <= CountMask,
+		    "Page counts must fit in a page tag.");
+    }
+
+    /// The size of the spans that malloc (sz) returns.
+    static inline size_t goodSize (size_t sz) {
+      size_t pages = (sz + PageSize - 1) / PageSize;
+      return ((pages == 0) ? 1 : pages) * PageSize;
+    }
+
+    inline void * malloc (size_t sz) {
+      size_t dirty;
+      return mallocClean (sz, dirty);
+    }
+
+    /// Like malloc, and sets dirty to how many of the span's leading
+    /// bytes may be nonzero; the rest are known to be zero. A free span
+    /// with no dirty pages is all zero past its first page, which holds
+    /// its free-list links.
+    void * mallocClean (size_t sz, size_t& dirty) {
+      size_t pages = (sz + PageSize - 1) / PageSize;
+      if (pages == 0) {
+	pages = 1;
+      }
+      if (pages > UsablePages) {
+	return nullptr;
+      }
+      auto * f = findFit (pages);
+      if (f == nullptr) {
+	if (!addArena()) {
+	  return nullptr;
+	}
+	f = findFit (pages);
+	assert (f != nullptr);
+      }
+      auto * a = arenaOf (f);
+      auto first = pageOf (a, f);
+      auto available = (size_t) (a->map[first] & CountMask);
+      auto freeDirty = f->dirty;
+      removeFree (f);
+      if (available > pages) {
+	// Assume the dirty pages are spread evenly over the span, but
+	// round up: the rest is only clean if the whole span was.
+	insertFree (a, first + pages, available - pages,
+		    (freeDirty * (available - pages) + available - 1) / available);
+      }
+      dirty = (((freeDirty == 0) && ReleasedPagesAreZero) ? 1 : pages) * PageSize;
+      // Tag the head with the span's length, and every other page with
+      // its distance from the head.
+      a->map[first] = Head | (uint32_t) pages;
+      for (size_t i = 1; i < pages; i++) {
+	a->map[first + i] = (uint32_t) i;
+      }
+      _inUsePages += pages;
+      return addressOf (a, first);
+    }
+
+    void free (void * ptr) {
+      auto * head = reinterpret_cast<char *>(span (ptr));
+      if (head == nullptr) {
+	// Not a live span: drop it.
+	return;
+      }
+      auto * a = arenaOf (head);
+      auto first = pageOf (a, head);
+      auto pages = (size_t) (a->map[first] & CountMask);
+      _inUsePages -= pages;
+      a->map[first] = 0;
+      auto dirty = pages;
+
+      // Coalesce with free neighbours. Their tags now lie inside the
+      // merged span, so clear them; a stale tag could otherwise make a
+      // double free look valid.
+      if (first > HeaderPages) {
+	auto tag = a->map[first - 1];
+	if (tag & Free) {
+	  auto n = (size_t) (tag & CountMask);
+	  auto * f = freeSpan (a, first - n);
+	  dirty += f->dirty;
+	  removeFree (f);
+	  a->map[first - 1] = 0;
+	  first -= n;
+	  pages += n;
+	  a->map[first] = 0;
+	}
+      }
+      auto next = first + pages;
+      if (next < NumPages) {
+	auto tag = a->map[next];
+	if (tag & Free) {
+	  auto n = (size_t) (tag & CountMask);
+	  auto * f = freeSpan (a, next);
+	  dirty += f->dirty;
+	  removeFree (f);
+	  a->map[next] = 0;
+	  a->map[next + n - 1] = 0;
+	  pages += n;
+	}
+      }
+      // Released neighbours stay clean, so purges are not triggered
+      // (and their pages not released again) on their account.
+      insertFree (a, first, pages, dirty);
+
+      auto allowed = _inUsePages * RetainFraction / 100;
+      if (allowed < RetainSlop / PageSize) {
+	allowed = RetainSlop / PageSize;
+      }
+      if (_dirtyPages > allowed) {
+	// Release down to half the allowance, so that a program hovering
+	// at the threshold does not purge on every free.
+	purge (allowed / 2);
+      }
+    }
+
+    /// Release dirty free spans, largest first, until at most target
+    /// pages are dirty. Arenas that are entirely free are unmapped
+    /// instead, except the last one.
+    void purge (size_t target = 0) {
+      for (int b = NumBins - 1; (b >= 0) && (_dirtyPages > target); b--) {
+	auto * f = _bins[b];
+	while ((f != nullptr) && (_dirtyPages > target)) {
+	  auto * next = f->next;
+	  auto * a = arenaOf (f);
+	  auto pages = (size_t) (a->map[pageOf (a, f)] & CountMask);
+	  if ((pages == UsablePages) && ((a != _arenas) || (a->next != nullptr))) {
+	    removeFree (f);
+	    removeArena (a);
+	  } else if (f->dirty > 0) {
+	    // Keep the first page: it holds the free-list links.
+	    if (pages > 1) {
+	      release (reinterpret_cast<char *>(f) + PageSize, (pages - 1) * PageSize);
+	    }
+	    _dirtyPages -= f->dirty;
+	    f->dirty = 0;
+	  }
+	  f = next;
+	}
+      }
+    }
+
+    /// Is ptr inside one of the arenas?
+    static inline bool isSpan (void * ptr) {
+      auto n = (size_t) ptr / ArenaSize;
+      if (n >= MaxArenas) {
+	return false;
+      }
+      auto word = registry (n / 64).load (std::memory_order_acquire);
+      return (word >> (n % 64)) & 1;
+    }
+
+    /// The start of the live span holding ptr, or null if there is none.
+    static inline void * span (void * ptr) {
+      if (!isSpan (ptr)) {
+	return nullptr;
+      }
+      auto * a = arenaOf (ptr);
+      auto page = pageOf (a, ptr);
+      auto tag = a->map[page];
+      if ((tag & (Head | Free)) == 0) {
+	// An inner page: its tag is the distance to the head.
+	if ((tag == 0) || (tag > page)) {
+	  return nullptr;
+	}
+	page -= tag;
+	tag = a->map[page];
+      }
+      if ((tag & (Head | Free)) != Head) {
+	return nullptr;
+      }
+      return addressOf (a, page);
+    }
+
+    /// The number of bytes from ptr to the end of its span (0 if ptr is
+    /// not in a live span).
+    static inline size_t getSize (void * ptr) {
+      auto * head = reinterpret_cast<char *>(span (ptr));
+      if (head == nullptr) {
+	return 0;
+      }
+      auto * a = arenaOf (head);
+      auto pages = (size_t) (a->map[pageOf (a, head)] & CountMask);
+      return pages * PageSize - (size_t) (reinterpret_cast<char *>(ptr) - head);
+    }
+
+  private:
+
+    enum : uint32_t {
+      Head = 1U << 31,       // The first page of a live span.
+      Free = 1U << 30,       // The first or last page of a free span.
+      CountMask = Free - 1   // With Head or Free: the span's length in pages.
+    };
+
+    static constexpr size_t NumPages = ArenaSize / PageSize;
+
+    /// The arena's bookkeeping, at its start.
+    struct Arena {
+      Arena * prev;
+      Arena * next;
+      uint32_t map[NumPages];
+    };
+
+    static constexpr size_t HeaderPages = (sizeof(Arena) + PageSize - 1) / PageSize;
+    static constexpr size_t UsablePages = NumPages - HeaderPages;
+
+    /// Free-list links, in the first page of each free span.
+    struct FreeSpan {
+      FreeSpan * prev;
+      FreeSpan * next;
+      /// How many of the span's pages may still be resident.
+      size_t dirty;
+    };
+
+    static constexpr int log2 (size_t n) {
+      return (n <= 1) ? 0 : 1 + log2 (n / 2);
+    }
+
+    /// Bins 0-63 hold spans of exactly 1-64 pages; above that, four
+    /// bins per power of two.
+    enum { NumBins = 64 + 4 * (log2 (NumPages) - 6) };
+
+    static inline int countTrailingZeros (uint64_t v) {
+      assert (v != 0);
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward64 (&index, v);
+      return (int) index;
+#else
+      return __builtin_ctzll (v);
+#endif
+    }
+
+    static inline int binOf (size_t pages) {
+      if (pages <= 64) {
+	return (int) pages - 1;
+      }
+      auto lg = log2 (pages);
+      return 64 + 4 * (lg - 6) + (int) ((pages >> (lg - 2)) & 3);
+    }
+
+    /// One bit per possible arena, for isSpan.
+    enum : size_t { AddressBits = (sizeof(void *) == 8) ? 48 : 32 };
+    enum : size_t { MaxArenas = ((size_t) 1 << AddressBits) / ArenaSize };
+
+    static inline std::atomic<uint64_t>& registry (size_t word) {
+      static std::atomic<uint64_t> theRegistry[(MaxArenas + 63) / 64];
+      return theRegistry[word];
+    }
+
+    static inline Arena * arenaOf (void * ptr) {
+      return reinterpret_cast<Arena *>((size_t) ptr & ~(ArenaSize - 1));
+    }
+
+    static inline size_t pageOf (Arena * a, void * ptr) {
+      return (size_t) (reinterpret_cast<char *>(ptr) - reinterpret_cast<char *>(a)) / PageSize;
+    }
+
+    static inline char * addressOf (Arena * a, size_t page) {
+      return reinterpret_cast<char *>(a) + page * PageSize;
+    }
+
+    static inline FreeSpan * freeSpan (Arena * a, size_t page) {
+      return reinterpret_cast<FreeSpan *>(addressOf (a, page));
+    }
+
+    void insertFree (Arena * a, size_t first, size_t pages, size_t dirty) {
+      a->map[first] = Free | (uint32_t) pages;
+      a->map[first + pages - 1] = Free | (uint32_t) pages;
+      auto * f = freeSpan (a, first);
+      auto b = binOf (pages);
+      f->prev = nullptr;
+      f->next = _bins[b];
+      f->dirty = dirty;
+      if (f->next) {
+	f->next->prev = f;
+      }
+      _bins[b] = f;
+      _nonEmpty[b / 64] |= (uint64_t) 1 << (b % 64);
+      _dirtyPages += dirty;
+    }
+
+    void removeFree (FreeSpan * f) {
+      auto * a = arenaOf (f);
+      auto pages = (size_t) (a->map[pageOf (a, f)] & CountMask);
+      auto b = binOf (pages);
+      if (f->prev) {
+	f->prev->next = f->next;
+      } else {
+	_bins[b] = f->next;
+	if (_bins[b] == nullptr) {
+	  _nonEmpty[b / 64] &= ~((uint64_t) 1 << (b % 64));
+	}
+      }
+      if (f->next) {
+	f->next->prev = f->prev;
+      }
+      _dirtyPages -= f->dirty;
+    }
+
+    /// A free span of at least the given length, or null.
+    FreeSpan * findFit (size_t pages) {
+      auto b = binOf (pages);
+      // Spans in the first bin may be too short; any in a later one fit.
+      for (auto * f = _bins[b]; f != nullptr; f = f->next) {
+	auto * a = arenaOf (f);
+	if ((a->map[pageOf (a, f)] & CountMask) >= pages) {
+	  return f;
+	}
+      }
+      for (int w = (b + 1) / 64; w < (NumBins + 63) / 64; w++) {
+	auto bits = _nonEmpty[w];
+	if (w == (b + 1) / 64) {
+	  bits &= ~(uint64_t) 0 << ((b + 1) % 64);
+	}
+	if (bits) {
+	  return _bins[w * 64 + countTrailingZeros (bits)];
+	}
+      }
+      return nullptr;
+    }
+
+    bool addArena() {
+      auto * ptr = _source.malloc (ArenaSize);
+      if (ptr == nullptr) {
+	return false;
+      }
+      assert ((size_t) ptr % ArenaSize == 0);
+      auto * a = new (ptr) Arena;
+      a->prev = nullptr;
+      a->next = _arenas;
+      if (_arenas) {
+	_arenas->prev = a;
+      }
+      _arenas = a;
+      auto n = (size_t) a / ArenaSize;
+      registry (n / 64).fetch_or ((uint64_t) 1 << (n % 64), std::memory_order_release);
+      // Fresh from the OS, so nothing is resident yet.
+      insertFree (a, HeaderPages, UsablePages, 0);
+      return true;
+    }
+
+#if defined(__linux__)
+    /// Released pages read back as zero (and arenas start out zero).
+    enum { ReleasedPagesAreZero = 1 };
+
+    static void release (void * ptr, size_t sz) {
+      madvise (ptr, sz, MADV_DONTNEED);
+    }
+#else
+    /// Released pages may keep their contents.
+    enum { ReleasedPagesAreZero = 0 };
+
+    static void release (void * ptr, size_t sz) {
+      HL::MmapWrapper::release (ptr, sz);
+    }
+#endif
+
+    void removeArena (Arena * a) {
+      if (a->prev) {
+	a->prev->next = a->next;
+      } else {
+	_arenas = a->next;
+      }
+      if (a->next) {
+	a->next->prev = a->prev;
+      }
+      auto n = (size_t) a / ArenaSize;
+      registry (n / 64).fetch_and (~((uint64_t) 1 << (n % 64)), std::memory_order_release);
+      _source.free (a, ArenaSize);
+    }
+
+    /// Where arenas come from.
+    AlignedMmapInstance<ArenaSize> _source;
+
+    /// Every arena, most recent first.
+    Arena * _arenas;
+
+    /// Pages in live spans.
+    size_t _inUsePages;
+
+    /// Pages in free spans that may still be resident.
+    size_t _dirtyPages;
+
+    /// One bit per non-empty bin.
+    uint64_t _nonEmpty[(NumBins + 63) / 64];
+
+    /// The free spans, by length.
+    FreeSpan * _bins[NumBins] {};
+
+  };
+
+}
+
+#endif
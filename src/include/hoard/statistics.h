@@ -17,16 +17,78 @@
 #define HOARD_STATISTICS_H
 
 #include <atomic>
+#include <cstdint>
 
 namespace Hoard {
 
+  /**
+   * @class RemoteStatistics
+   * @brief In-use and allocated deltas posted by threads that do not own a bin.
+   *
+   * Remote updates (draining another heap's delayed frees, reclaiming
+   * its superblocks) are rare, so they pay for an atomic add here; the
+   * owner folds the accumulated deltas into its Statistics when it
+   * drains. Keep these away from the owner's counters (see HoardManager)
+   * so that remote writes don't bounce the owner's cache line.
+   */
+  class RemoteStatistics {
+  public:
+    RemoteStatistics()
+      : _inUse(0),
+        _allocated(0)
+    {}
+
+    /// Post a delta (any thread).
+    inline void adjust(int64_t inUseDelta, int64_t allocatedDelta) {
+      if (inUseDelta) {
+        _inUse.fetch_add(inUseDelta, std::memory_order_relaxed);
+      }
+      if (allocatedDelta) {
+        _allocated.fetch_add(allocatedDelta, std::memory_order_relaxed);
+      }
+    }
+
+    /// Cheap check for pending deltas (plain loads).
+    inline bool isPending() const {
+      return _inUse.load(std::memory_order_relaxed) || _allocated.load(std::memory_order_relaxed);
+    }
+
+    /// Pending deltas, for threshold checks (any thread).
+    inline int64_t pendingInUse() const {
+      return _inUse.load(std::memory_order_relaxed);
+    }
+
+    inline int64_t pendingAllocated() const {
+      return _allocated.load(std::memory_order_relaxed);
+    }
+
+    /// Take (and clear) all pending deltas.
+    inline void take(int64_t& inUseDelta, int64_t& allocatedDelta) {
+      inUseDelta = _inUse.exchange(0, std::memory_order_relaxed);
+      allocatedDelta = _allocated.exchange(0, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<int64_t> _inUse;
+    std::atomic<int64_t> _allocated;
+  };
+
   /**
    * @class Statistics
-   * @brief Tracks in-use and allocated object counts with atomic operations.
+   * @brief Tracks in-use and allocated object counts for one bin.
+   *
+   * Only the bin's owner writes these counters: the heap's exclusive
+   * owner, or whoever holds the heap lock (or, for the global heap, the
+   * bin lock). Updates are therefore plain loads and stores -- the
+   * atomics are relaxed and only there so that unsynchronized readers
+   * see whole values. Other threads post changes to a RemoteStatistics,
+   * which the owner folds in when it drains delayed frees.
    *
-   * Uses relaxed memory ordering for eventual consistency. This is safe
-   * because the threshold function has hysteresis (2*SUPERBLOCK_SIZE objects)
-   * which far exceeds any temporary inconsistency from concurrent operations.
+   * Readers (the threshold checks) add in the pending remote deltas,
+   * since a thread that only frees never folds them in. They may
+   * still see slightly stale values; that is safe because the
+   * threshold function has hysteresis (2*SUPERBLOCK_SIZE objects),
+   * which far exceeds any remaining skew.
    */
   class Statistics {
   public:
@@ -35,58 +97,59 @@ namespace Hoard {
         _allocated(0)
     {}
 
-    /// Get current in-use count (relaxed read).
-    inline unsigned int getInUse() const {
+    /// Get current in-use count.
+    inline uint64_t getInUse() const {
       return _inUse.load(std::memory_order_relaxed);
     }
 
-    /// Get current allocated count (relaxed read).
-    inline unsigned int getAllocated() const {
+    /// Get current allocated count.
+    inline uint64_t getAllocated() const {
       return _allocated.load(std::memory_order_relaxed);
     }
 
-    /// Atomically increment in-use count (for allocation).
+    /// Increment in-use count (for allocation; owner only).
     inline void incrementInUse() {
-      _inUse.fetch_add(1, std::memory_order_relaxed);
+      setInUse(getInUse() + 1);
     }
 
-    /// Atomically decrement in-use count (for free).
+    /// Decrement in-use count (for free; owner only).
     inline void decrementInUse() {
-      _inUse.fetch_sub(1, std::memory_order_relaxed);
+      setInUse(getInUse() - 1);
     }
 
-    /// Bulk adjustment for superblock transfer.
+    /// Bulk adjustment for superblock transfer (owner only).
     /// @param inUseDelta Objects in use to add (negative to subtract)
     /// @param allocatedDelta Total objects to add (negative to subtract)
-    inline void adjustForSuperblock(int inUseDelta, int allocatedDelta) {
-      if (inUseDelta > 0) {
-        _inUse.fetch_add(static_cast<unsigned int>(inUseDelta), std::memory_order_relaxed);
-      } else if (inUseDelta < 0) {
-        _inUse.fetch_sub(static_cast<unsigned int>(-inUseDelta), std::memory_order_relaxed);
-      }
-      if (allocatedDelta > 0) {
-        _allocated.fetch_add(static_cast<unsigned int>(allocatedDelta), std::memory_order_relaxed);
-      } else if (allocatedDelta < 0) {
-        _allocated.fetch_sub(static_cast<unsigned int>(-allocatedDelta), std::memory_order_relaxed);
+    inline void adjustForSuperblock(int64_t inUseDelta, int64_t allocatedDelta) {
+      setInUse(getInUse() + inUseDelta);
+      setAllocated(getAllocated() + allocatedDelta);
+    }
+
+    /// Fold in deltas posted by other threads (owner only).
+    inline void fold(RemoteStatistics& remote) {
+      if (remote.isPending()) {
+        int64_t inUseDelta, allocatedDelta;
+        remote.take(inUseDelta, allocatedDelta);
+        adjustForSuperblock(inUseDelta, allocatedDelta);
       }
     }
 
-    /// Set in-use count (for compatibility with existing code).
-    inline void setInUse(unsigned int u) {
+    /// Set in-use count (owner only).
+    inline void setInUse(uint64_t u) {
       _inUse.store(u, std::memory_order_relaxed);
     }
 
-    /// Set allocated count (for compatibility with existing code).
-    inline void setAllocated(unsigned int a) {
+    /// Set allocated count (owner only).
+    inline void setAllocated(uint64_t a) {
       _allocated.store(a, std::memory_order_relaxed);
     }
 
   private:
-    /// The number of objects in use (atomic for lock-free updates).
-    std::atomic<unsigned int> _inUse;
+    /// The number of objects in use.
+    std::atomic<uint64_t> _inUse;
 
-    /// The number of objects allocated (atomic for lock-free updates).
-    std::atomic<unsigned int> _allocated;
+    /// The number of objects allocated.
+    std::atomic<uint64_t> _allocated;
   };
 
 }
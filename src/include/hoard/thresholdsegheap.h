@@ -19,7 +19,15 @@
 namespace Hoard {
 
   // Allows superheap to hold at least ThresholdSlop but no more than
-  // ThresholdFraction% more memory than client currently holds.
+  // ThresholdFraction% more memory than client currently holds, plus
+  // whatever the client freed since its recent peak; that peak decays
+  // towards what the client holds as the heap is used.
+  //
+  // Past that budget, cached objects go back to BigHeap one at a time,
+  // from the class reused least lately (the largest, among equals),
+  // until the cache is within budget again. A dip in load thus gives
+  // memory back gradually, and the classes a program keeps reusing
+  // stay cached through it.
 
   template <int ThresholdFraction, // % over current allowed in superheap.
 	    int ThresholdSlop,     // constant amount allowed in superheap.
@@ -35,37 +43,61 @@ namespace Hoard {
 
     ThresholdSegHeap()
       : _currLive (0),
-	_maxLive (0),
-	_maxFraction (1.0 + (double) ThresholdFraction / 100.0),
-	_cleared (false)
-    {}
+	_peakLive (0),
+	_cached (0),
+	_ops (0)
+    {
+      for (int i = 0; i < NumBins; i++) {
+	_cachedBytes[i] = 0;
+	_reuse[i] = 0;
+      }
+    }
 
     size_t getSize (void * ptr) {
       return BigHeap::getSize(ptr);
     }
 
+    /// The size of the objects that malloc (sz) returns: the largest of
+    /// its class, so that they can be cached.
+    static inline size_t goodSize (size_t sz) {
+      return (sz >= MaxObjectSize) ? sz : getClassMaxSize (getSizeClass (sz));
+    }
+
     void * malloc (size_t sz) {
+      size_t dirty;
+      return mallocClean (sz, dirty);
+    }
+
+    /// Like malloc, and sets dirty to how many of the object's leading
+    /// bytes may be nonzero: all of a cached object's, while BigHeap
+    /// says for the rest.
+    void * mallocClean (size_t sz, size_t& dirty) {
       if (sz >= MaxObjectSize) {
-	return BigHeap::malloc (sz);
+	return BigHeap::mallocClean (sz, dirty);
       }
-      // Once the amount of cached memory in the superheap exceeds the
-      // desired threshold over max live requested by the client, dump
-      // it all.
       const int sizeClass = getSizeClass (sz);
       const size_t maxSz = getClassMaxSize (sizeClass);
       if (sizeClass >= NumBins) {
-	return BigHeap::malloc (maxSz);
+	return BigHeap::mallocClean (maxSz, dirty);
       } else {
 	void * ptr = _heap[sizeClass].malloc (maxSz);
 	if (ptr == nullptr) {
-	  return BigHeap::malloc (maxSz);
+	  ptr = BigHeap::mallocClean (maxSz, dirty);
+	  if (ptr == nullptr) {
+	    return nullptr;
+	  }
+	} else {
+	  assert (getSize(ptr) <= maxSz);
+	  dirty = getSize (ptr);
+	  _cachedBytes[sizeClass] -= getSize (ptr);
+	  _cached -= getSize (ptr);
+	  _reuse[sizeClass]++;
 	}
-	assert (getSize(ptr) <= maxSz);
 	_currLive += getSize (ptr);
-	if (_currLive >= _maxLive) {
-	  _maxLive = _currLive;
-	  _cleared = false;
+	if (_currLive > _peakLive) {
+	  _peakLive = _currLive;
 	}
+	tick();
 	return ptr;
       }
     }
@@ -86,17 +118,10 @@ namespace Hoard {
 	_currLive -= sz;
       }
       _heap[cl].free (ptr);
-      bool crossedThreshold = (double) _maxLive > _maxFraction * (double) _currLive;
-      if ((_currLive > ThresholdSlop) && crossedThreshold && !_cleared)
-	{
-	  // When we drop below the threshold, clear the heap.
-	  for (int i = 0; i < NumBins; i++) {
-	    _heap[i].clear();
-	  }
-	  // We won't clear again until we reach maxlive again.
-	  _cleared = true;
-	  _maxLive = _currLive;
-	}
+      _cachedBytes[cl] += sz;
+      _cached += sz;
+      tick();
+      trim();
     }
     
     void free (void * ptr) {
@@ -105,19 +130,119 @@ namespace Hoard {
       free(ptr, sz);
     }
 
+    /// Resize an object to hold sz bytes, without copying it (see
+    /// BigHeap::resize). Null, leaving ptr as is, means the caller
+    /// should copy it instead: the resize failed, or a cached object
+    /// would serve, whose pages are already in memory. Unless mayMove,
+    /// only an in-place resize counts.
+    void * resize (void * ptr, size_t sz, bool mayMove = true) {
+      const size_t oldSz = getSize (ptr);
+      // Keep to class sizes, so that the object can be cached later.
+      const size_t newSz = goodSize (sz);
+      if (newSz == oldSz) {
+	return ptr;
+      }
+      if (mayMove && (newSz > oldSz) && isCacheable (newSz) && (_cachedBytes[getSizeClass (newSz)] > 0)) {
+	return nullptr;
+      }
+      void * q = BigHeap::resize (ptr, newSz, mayMove);
+      if (q == nullptr) {
+	return nullptr;
+      }
+      // Only cacheable objects count as live.
+      if (isCacheable (oldSz)) {
+	_currLive = (_currLive < oldSz) ? 0 : _currLive - oldSz;
+      }
+      if (isCacheable (newSz)) {
+	_currLive += newSz;
+	if (_currLive > _peakLive) {
+	  _peakLive = _currLive;
+	}
+      }
+      return q;
+    }
+
   private:
 
+    static inline bool isCacheable (size_t sz) {
+      return (sz < MaxObjectSize) && (getSizeClass (sz) < NumBins);
+    }
+
+    /// Every this many mallocs and frees, halve every class's reuse
+    /// count and the distance from the peak to what is live, so that
+    /// what happened long ago counts for less.
+    enum { DecayWindow = 256 };
+
+    inline void tick() {
+      if (++_ops < DecayWindow) {
+	return;
+      }
+      _ops = 0;
+      for (int i = 0; i < NumBins; i++) {
+	_reuse[i] /= 2;
+      }
+      if (_peakLive > _currLive) {
+	_peakLive = _currLive + (_peakLive - _currLive) / 2;
+      } else {
+	_peakLive = _currLive;
+      }
+    }
+
+    /// Release cached objects until the cache is within budget.
+    void trim() {
+      size_t budget = (size_t) ((double) _currLive * ThresholdFraction / 100.0);
+      if (_peakLive > _currLive) {
+	budget += _peakLive - _currLive;
+      }
+      if (budget < (size_t) ThresholdSlop) {
+	budget = ThresholdSlop;
+      }
+      while (_cached > budget) {
+	// The coldest class; among equally cold ones, the largest.
+	int victim = -1;
+	for (int i = NumBins - 1; i >= 0; i--) {
+	  if ((_cachedBytes[i] > 0) &&
+	      ((victim < 0) || (_reuse[i] < _reuse[victim]))) {
+	    victim = i;
+	  }
+	}
+	if (victim < 0) {
+	  break;
+	}
+	void * ptr = _heap[victim].malloc (getClassMaxSize (victim));
+	if (ptr == nullptr) {
+	  // Should not happen; forget whatever we thought was there.
+	  _cached -= _cachedBytes[victim];
+	  _cachedBytes[victim] = 0;
+	  continue;
+	}
+	auto sz = getSize (ptr);
+	_cachedBytes[victim] -= sz;
+	_cached -= sz;
+	// Each object released makes its class look colder, so a class
+	// that is only somewhat warm drains gradually.
+	_reuse[victim] /= 2;
+	BigHeap::free (ptr);
+      }
+    }
+
     /// The current amount of live memory held by a client of this heap.
     unsigned long _currLive;
 
-    /// The maximum amount of live memory held by a client of this heap.
-    unsigned long _maxLive;
+    /// The most live memory lately.
+    unsigned long _peakLive;
+
+    /// The bytes cached in all classes.
+    unsigned long _cached;
+
+    /// The bytes cached in each class.
+    unsigned long _cachedBytes[NumBins];
 
-    /// Maximum fraction calculation.
-    const double _maxFraction;
+    /// How often each class has been reused, lately.
+    unsigned int _reuse[NumBins];
 
-    /// Have we already cleared out the superheap?
-    bool _cleared;
+    /// Mallocs and frees since the last decay.
+    unsigned int _ops;
 
     LittleHeap _heap[NumBins];
   };
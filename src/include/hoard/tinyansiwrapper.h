@@ -0,0 +1,78 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_TINYANSIWRAPPER_H
+#define HOARD_TINYANSIWRAPPER_H
+
+#include <cstddef>
+#include <utility>
+
+#include "heaplayers.h"
+#include "hoardconstants.h"
+
+namespace Hoard {
+
+  /**
+   * @class TinyANSIWrapper
+   * @brief HL::ANSIWrapper, except that tiny requests keep their size.
+   *
+   * ANSIWrapper rounds every request up to the platform's malloc
+   * alignment, which would put tiny requests in the 16-byte class.
+   * Requests of 1 to TinyObjectSize bytes skip that rounding; with no
+   * tiny class, this is just ANSIWrapper.
+   */
+  template <class SuperHeap>
+  class TinyANSIWrapper : public HL::ANSIWrapper<SuperHeap> {
+  public:
+
+    template <class... Args>
+    TinyANSIWrapper (Args&&... args)
+      : HL::ANSIWrapper<SuperHeap> (std::forward<Args>(args)...)
+    {}
+
+    inline void * malloc (size_t sz) {
+      if ((TinyObjectSize != 0) && (sz - 1 < (size_t) TinyObjectSize)) {
+	return SuperHeap::malloc (sz);
+      }
+      return HL::ANSIWrapper<SuperHeap>::malloc (sz);
+    }
+
+    /// Put n objects of sz bytes into ptrs; returns how many.
+    inline size_t mallocBatch (size_t sz, size_t n, void ** ptrs) {
+      // ANSIWrapper gives empty requests a (non-tiny) object.
+      if (sz == 0) {
+	sz = TinyObjectSize + 1;
+      }
+      return SuperHeap::mallocBatch (sz, n, ptrs);
+    }
+
+    using HL::ANSIWrapper<SuperHeap>::free;
+
+    /// Free an object that malloc was asked for sz bytes of.
+    inline void free (void * ptr, size_t sz) {
+      if (ptr == nullptr) {
+	return;
+      }
+      // ANSIWrapper gives empty requests a (non-tiny) object.
+      if (sz == 0) {
+	sz = TinyObjectSize + 1;
+      }
+      SuperHeap::free (ptr, sz);
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/*
+ * @file   hoardallocator.h
+ * @brief  C++17 allocators backed by Hoard, for programs linked with it.
+ *
+ * hoard::memory_resource is a std::pmr::memory_resource that allocates
+ * from the calling thread's heap or from a private heap (see
+ * hoard_heap_create); hoard::allocator<T> is a standard allocator that
+ * allocates from the calling thread's heap. Both give objects back
+ * with their sizes, which saves small objects a look at their
+ * superblock. Header only: everything goes through hoard.h.
+ */
+
+#ifndef HOARD_HOARDALLOCATOR_H
+#define HOARD_HOARDALLOCATOR_H
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+#include "hoard.h"
+
+namespace hoard {
+
+  namespace detail {
+
+    /// The hoard_allocx flags for an alignment (a power of two).
+    inline int alignmentFlags (std::size_t alignment) noexcept {
+      int lg = 0;
+      while (((std::size_t) 1 << lg) < alignment) {
+	lg++;
+      }
+      return HOARD_ALLOCX_LG_ALIGN(lg);
+    }
+
+    /// Every object Hoard returns is at least this aligned.
+    enum { MinAlignment = 8 };
+
+  }
+
+  /**
+   * @class memory_resource
+   * @brief A memory resource that allocates from Hoard's heaps.
+   *
+   * By default, memory comes from the calling thread's heap: any
+   * thread can give it back, so all such resources compare equal.
+   * Given a private heap, memory comes from that heap instead, which
+   * must outlive the resource (and everything allocated through it,
+   * unless destroying the heap is how it is freed). Objects too large
+   * for a private heap come from the thread's heap, so destroying the
+   * heap does not free them.
+   */
+  class memory_resource : public std::pmr::memory_resource {
+  public:
+
+    memory_resource() noexcept
+      : _heap (nullptr)
+    {}
+
+    explicit memory_resource (hoard_heap * heap) noexcept
+      : _heap (heap)
+    {}
+
+    /// The private heap this resource allocates from, or null.
+    hoard_heap * heap() const noexcept {
+      return _heap;
+    }
+
+  private:
+
+    void * do_allocate (std::size_t bytes, std::size_t alignment) override {
+      void * ptr;
+      if (_heap == nullptr) {
+	ptr = hoard_allocx (bytes, detail::alignmentFlags (alignment));
+      } else if (alignment <= detail::MinAlignment) {
+	ptr = hoard_heap_alloc (_heap, bytes);
+      } else {
+	// Private heaps take interior pointers back, so round up
+	// within a larger object.
+	ptr = hoard_heap_alloc (_heap, bytes + alignment - detail::MinAlignment);
+	if (ptr != nullptr) {
+	  ptr = (void *) (((std::size_t) ptr + alignment - 1) & ~(alignment - 1));
+	}
+      }
+      if ((ptr == nullptr) && (_heap != nullptr)) {
+	// Too large for the private heap: take it from the thread's
+	// heap, which hoard_heap_free hands it back to.
+	ptr = hoard_allocx (bytes, detail::alignmentFlags (alignment));
+      }
+      if (ptr == nullptr) {
+	throw std::bad_alloc();
+      }
+      return ptr;
+    }
+
+    void do_deallocate (void * ptr, std::size_t bytes, std::size_t alignment) override {
+      if (_heap == nullptr) {
+	hoard_sdallocx (ptr, bytes, detail::alignmentFlags (alignment));
+      } else {
+	hoard_heap_free (_heap, ptr);
+      }
+    }
+
+    bool do_is_equal (const std::pmr::memory_resource& other) const noexcept override {
+      auto * o = dynamic_cast<const memory_resource *>(&other);
+      return (o != nullptr) && (o->_heap == _heap);
+    }
+
+    hoard_heap * _heap;
+  };
+
+  /**
+   * @class allocator
+   * @brief A standard allocator that allocates from the calling
+   *        thread's Hoard heap, and frees with the object's size.
+   */
+  template <class T>
+  class allocator {
+  public:
+
+    typedef T value_type;
+    typedef std::true_type is_always_equal;
+    typedef std::true_type propagate_on_container_move_assignment;
+
+    allocator() noexcept = default;
+
+    template <class U>
+    allocator (const allocator<U>&) noexcept {}
+
+    T * allocate (std::size_t n) {
+      if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+	throw std::bad_array_new_length();
+      }
+      auto * ptr = hoard_allocx (n * sizeof(T), detail::alignmentFlags (alignof(T)));
+      if (ptr == nullptr) {
+	throw std::bad_alloc();
+      }
+      return static_cast<T *>(ptr);
+    }
+
+    void deallocate (T * ptr, std::size_t n) noexcept {
+      hoard_sdallocx (ptr, n * sizeof(T), detail::alignmentFlags (alignof(T)));
+    }
+  };
+
+  template <class T, class U>
+  bool operator== (const allocator<T>&, const allocator<U>&) noexcept {
+    return true;
+  }
+
+  template <class T, class U>
+  bool operator!= (const allocator<T>&, const allocator<U>&) noexcept {
+    return false;
+  }
+
+}
+
+#endif
@@ -61,6 +61,20 @@ namespace Hoard {
       return reinterpret_cast<void *>(p + 1);
     }
 
+    /// Like malloc, and sets dirty to how many of the object's leading
+    /// bytes may be nonzero (see SuperHeap::mallocClean).
+    void * mallocClean (size_t sz, size_t& dirty) {
+      const size_t headerSize = sizeof(typename SuperblockType::Header);
+      void * ptr = theHeap.mallocClean (sz + headerSize, dirty);
+      if (ptr == nullptr) {
+	return nullptr;
+      }
+      typename SuperblockType::Header * p
+	= new (ptr) typename SuperblockType::Header (sz, sz);
+      dirty = (dirty > headerSize) ? dirty - headerSize : 0;
+      return reinterpret_cast<void *>(p + 1);
+    }
+
     INLINE static size_t getSize (void * ptr) {
       // Find the header (just before the pointer) and return the size
       // value stored there.
@@ -70,17 +84,38 @@ namespace Hoard {
     }
 
     INLINE void free (void * ptr) {
-      // Find the header (just before the pointer) and free the whole object.
+      // Find the header (just before the pointer) and free the whole
+      // object, header included.
       typename SuperblockType::Header * p;
       p = reinterpret_cast<typename SuperblockType::Header *>(ptr);
-      theHeap.free (reinterpret_cast<void *>(p - 1), getSize(ptr));
+      theHeap.free (reinterpret_cast<void *>(p - 1), getSize(ptr) + sizeof(*p));
     }
 
     INLINE void free (void * ptr, size_t sz) {
-      // Find the header (just before the pointer) and free the whole object.
+      // Find the header (just before the pointer) and free the whole
+      // object, header included.
       typename SuperblockType::Header * p;
       p = reinterpret_cast<typename SuperblockType::Header *>(ptr);
-      theHeap.free (reinterpret_cast<void *>(p - 1), sz);
+      theHeap.free (reinterpret_cast<void *>(p - 1), sz + sizeof(*p));
+    }
+
+    /// Resize the object at ptr to sz bytes, in place or (if mayMove)
+    /// by moving it (see SuperHeap::resize); null if that fails,
+    /// leaving ptr as is.
+    void * resize (void * ptr, size_t sz, bool mayMove = true) {
+      const size_t headerSize = sizeof(typename SuperblockType::Header);
+      typename SuperblockType::Header * p;
+      p = reinterpret_cast<typename SuperblockType::Header *>(ptr);
+      void * q = theHeap.resize (reinterpret_cast<void *>(p - 1),
+				 getSize(ptr) + headerSize,
+				 sz + headerSize,
+				 mayMove);
+      if (q == nullptr) {
+	return nullptr;
+      }
+      // The header came along; record the new size.
+      p = new (q) typename SuperblockType::Header (sz, sz);
+      return reinterpret_cast<void *>(p + 1);
     }
   };
 
@@ -94,6 +94,16 @@ namespace Hoard {
       }
     }
 
+    /// Get any superblock, even a full one, and remove it.
+    SuperblockType * getAny() {
+      if (_current) {
+	SuperblockType * s = _current;
+	_current = nullptr;
+	return s;
+      }
+      return SuperHeap::getAny();
+    }
+
     /// Put the superblock into the cache.
     inline void put (SuperblockType * s) {
       if (!s || (s == _current) || (!s->isValidSuperblock())) {
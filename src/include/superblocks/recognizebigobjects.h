@@ -0,0 +1,52 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_RECOGNIZEBIGOBJECTS_H
+#define HOARD_RECOGNIZEBIGOBJECTS_H
+
+namespace Hoard {
+
+  /**
+   * @class RecognizeBigObjects
+   * @brief Reports the sizes of big objects as well as of the objects
+   *        in SuperHeap's superblocks.
+   *
+   * Big objects start with a header of their own (see AddHeaderHeap),
+   * which need not be the kind of header that SuperHeap's superblocks
+   * have. HL::HybridHeap routes frees by the size that its small heap
+   * reports, so this layer goes under it: objects that are not in a
+   * valid superblock are looked up as big objects instead, and
+   * anything else has size 0.
+   */
+
+  template <class SuperHeap, class BigSuperblockType>
+  class RecognizeBigObjects : public SuperHeap {
+  public:
+    INLINE size_t getSize (void * ptr) {
+      auto * s = SuperHeap::getSuperblock (ptr);
+      if (s && s->isValidSuperblock()) {
+	return SuperHeap::getSize (ptr);
+      }
+      auto * b = BigSuperblockType::getSuperblock (ptr);
+      if (b && b->isValidSuperblock()) {
+	return b->getSize (ptr);
+      }
+      return 0;
+    }
+  };
+
+}
+
+#endif
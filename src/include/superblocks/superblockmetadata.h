@@ -0,0 +1,128 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_SUPERBLOCKMETADATA_H
+#define HOARD_SUPERBLOCKMETADATA_H
+
+#include <atomic>
+#include <cstddef>
+
+#include "heaplayers.h"
+#include "../hoard/hoardconstants.h"
+
+namespace Hoard {
+
+  /**
+   * @class SuperblockMetadataTable
+   * @brief Superblock headers kept apart from the superblocks themselves.
+   *
+   * Slots are indexed by superblock number (address / SuperblockSize)
+   * through a two-level radix table. Each leaf is one dense, separately
+   * mapped array of slots covering 2^LeafBits consecutive superblocks,
+   * so neighboring superblocks have neighboring headers. Leaves are
+   * created on demand and never released (neither are superblocks).
+   *
+   * The table depends only on the superblock and slot sizes, so every
+   * HoardSuperblock instantiation that shares a layout (e.g., the
+   * per-thread and global heaps' views of the same superblock) shares
+   * one table.
+   */
+  template <size_t SuperblockSize, size_t SlotSize>
+  class SuperblockMetadataTable {
+  public:
+
+    /// Storage for one header.
+    struct alignas(CACHE_LINE_SIZE) Slot {
+      char bytes[SlotSize];
+    };
+
+    /// The slot for the superblock at sb, or nullptr if its leaf does not exist.
+    static inline Slot * find (const void * sb) {
+      auto n = number (sb);
+      if (n >> NumberBits) {
+	return nullptr;
+      }
+      // Relaxed is enough: anyone holding a pointer into a superblock
+      // got it (through the application's own synchronization) after
+      // the superblock's leaf was installed.
+      auto * leaf = root()[n >> LeafBits].load (std::memory_order_relaxed);
+      if (leaf == nullptr) {
+	return nullptr;
+      }
+      return &leaf[n & (LeafSlots - 1)];
+    }
+
+    /// The slot for the superblock at sb, creating its leaf if
+    /// necessary. Returns nullptr if that fails.
+    static Slot * get (const void * sb) {
+      auto * s = find (sb);
+      if (s) {
+	return s;
+      }
+      auto n = number (sb);
+      if (n >> NumberBits) {
+	return nullptr;
+      }
+      auto& entry = root()[n >> LeafBits];
+      auto * leaf = reinterpret_cast<Slot *>(HL::MmapWrapper::map (LeafBytes));
+      if (leaf == nullptr) {
+	return nullptr;
+      }
+      Slot * expected = nullptr;
+      if (!entry.compare_exchange_strong (expected, leaf,
+					  std::memory_order_acq_rel,
+					  std::memory_order_acquire)) {
+	// Someone else installed this leaf first.
+	HL::MmapWrapper::unmap (leaf, LeafBytes);
+	leaf = expected;
+      }
+      return &leaf[n & (LeafSlots - 1)];
+    }
+
+  private:
+
+    static constexpr int log2 (size_t v) {
+      return (v <= 1) ? 0 : 1 + log2 (v >> 1);
+    }
+
+    static_assert((SuperblockSize & (SuperblockSize - 1)) == 0,
+		  "Superblock size must be a power of two.");
+
+    /// User-space addresses we cover (x86-64 and AArch64 both use 48).
+    static constexpr int AddressBits = 48;
+
+    static constexpr int NumberBits = AddressBits - log2 (SuperblockSize);
+
+    /// 2^16 slots per leaf: 16GB of 256K superblocks per leaf.
+    static constexpr int LeafBits = (NumberBits < 16) ? NumberBits : 16;
+    static constexpr int RootBits = NumberBits - LeafBits;
+    static constexpr size_t LeafSlots = (size_t) 1 << LeafBits;
+    static constexpr size_t LeafBytes = LeafSlots * sizeof(Slot);
+
+    static inline size_t number (const void * sb) {
+      return (size_t) sb >> log2 (SuperblockSize);
+    }
+
+    static inline std::atomic<Slot *> * root() {
+      // Zero-initialized static storage; pages are only touched as
+      // leaves get installed.
+      static std::atomic<Slot *> theRoot[1 << RootBits];
+      return theRoot;
+    }
+  };
+
+}
+
+#endif
@@ -24,6 +24,8 @@
 #define HOARD_TLAB_H
 
 #include "heaplayers.h"
+#include "../hoard/hoardconstants.h"
+#include "../hoard/privatesuperblockmap.h"
 
 // Branch prediction hints for hot paths (mimalloc-style optimization)
 #if defined(__GNUC__) || defined(__clang__)
@@ -47,8 +49,11 @@ namespace Hoard {
 	    size_t LargestObject,
 	    size_t LocalHeapThreshold,
 	    class SuperblockType,
+	    class BigSuperblockType,
 	    unsigned int SuperblockSize,
-	    class ParentHeap>
+	    class ParentHeap,
+	    class LargeCache,
+	    class ReallocHistoryType>
 
   class ThreadLocalAllocationBuffer {
 
@@ -60,7 +65,8 @@ namespace Hoard {
 
     ThreadLocalAllocationBuffer (ParentHeap * parent)
       : _parentHeap (parent),
-      	_localHeapBytes (0)
+      	_localHeapBytes (0),
+	_largeCache (parent)
     {
       static_assert(gcd<Alignment, DesiredAlignment>::value == DesiredAlignment,
 		    "Alignment mismatch.");
@@ -72,8 +78,22 @@ namespace Hoard {
       clear();
     }
 
-    inline static size_t getSize (void * ptr) {
-      return getSuperblock(ptr)->getSize (ptr);
+    /// The objects that realloc has been growing on this thread.
+    inline ReallocHistoryType& reallocHistory() {
+      return _reallocHistory;
+    }
+
+    inline size_t getSize (void * ptr) {
+      auto * s = getSuperblock (ptr);
+      if (TLAB_LIKELY(s && s->isValidSuperblock())) {
+	return s->getSize (ptr);
+      }
+      auto * b = getBigObject (ptr);
+      if (b) {
+	return b->getSize (ptr);
+      }
+      // Not in a superblock (e.g., a medium object): ask the parent.
+      return _parentHeap->getSize (ptr);
     }
 
     inline void * malloc (size_t sz) {
@@ -86,18 +106,55 @@ namespace Hoard {
       	  assert (_localHeapBytes >= sz);
       	  _localHeapBytes -= getClassSize (c);
       	  assert (getSize(ptr) >= sz);
-      	  assert ((size_t) ptr % Alignment == 0);
+      	  assert ((size_t) ptr % MinObjectAlignment == 0);
       	  return ptr;
       	}
       }
 
-      // Slow path: TLAB miss - get memory from parent heap.
+      // Slow path: TLAB miss - try the large-object cache, then get
+      // memory from parent heap.
+      if (sz > LargestObject) {
+	auto * ptr = _largeCache.malloc (sz);
+	if (ptr != nullptr) {
+	  return ptr;
+	}
+      }
       auto * ptr = _parentHeap->malloc (sz);
-      assert ((size_t) ptr % Alignment == 0);
+      assert ((size_t) ptr % MinObjectAlignment == 0);
       return ptr;
     }
 
 
+    /// Put n objects of sz bytes into ptrs; returns how many (fewer
+    /// than n only if memory runs out). Small objects come from the
+    /// local heap, and then straight from the parent's superblocks,
+    /// with one lock for each superblock's worth.
+    inline size_t mallocBatch (size_t sz, size_t n, void ** ptrs) {
+      size_t got = 0;
+      if (TLAB_LIKELY(sz <= LargestObject)) {
+	auto c = getSizeClass (sz);
+	while (got < n) {
+	  auto * ptr = _localHeap(c).get();
+	  if (ptr == nullptr) {
+	    break;
+	  }
+	  _localHeapBytes -= getClassSize (c);
+	  ptrs[got++] = ptr;
+	}
+	if (got < n) {
+	  got += _parentHeap->mallocBatch (getClassSize (c), n - got, ptrs + got);
+	}
+	return got;
+      }
+      for (; got < n; got++) {
+	ptrs[got] = malloc (sz);
+	if (ptrs[got] == nullptr) {
+	  break;
+	}
+      }
+      return got;
+    }
+
     inline void free (void * ptr) {
       auto * s = getSuperblock (ptr);
 
@@ -108,6 +165,13 @@ namespace Hoard {
       	ptr = s->normalize (ptr);
       	auto sz = s->getObjectSize ();
 
+      	if (TLAB_UNLIKELY(s->isPrivate())) {
+      	  // A private heap may clear this superblock at any time, so
+      	  // its objects go straight back to it.
+      	  _parentHeap->free (ptr);
+      	  return;
+      	}
+
       	if (TLAB_LIKELY((sz <= LargestObject) && (sz + _localHeapBytes <= LocalHeapThreshold))) {
       	  // Free small objects locally - no locks needed.
       	  assert (getSize(ptr) >= sizeof(HL::SLList::Entry *));
@@ -118,14 +182,112 @@ namespace Hoard {
       	  return;
       	}
 
-      	// Slow path: large object or TLAB full - free to parent heap.
+      	// Slow path: large object or TLAB full - cache it, or free to
+      	// parent heap.
+      	if ((sz > LargestObject) && _largeCache.free (ptr, sz)) {
+      	  return;
+      	}
       	_parentHeap->free (ptr);
+      	return;
+      }
+
+      // Not in a superblock: big objects have a header of their own,
+      // medium objects live in span arenas, and the parent heap drops
+      // anything else (reporting size 0).
+      size_t sz;
+      auto * b = getBigObject (ptr);
+      if (b) {
+	ptr = b->normalize (ptr);
+	sz = b->getObjectSize ();
+      } else {
+	sz = _parentHeap->getSize (ptr);
+      }
+      if ((sz > LargestObject) && _largeCache.free (ptr, sz)) {
+      	return;
+      }
+      _parentHeap->free (ptr);
+    }
+
+    /// Malloc from the parent heap, bypassing the local heap and the
+    /// large-object cache.
+    inline void * parentMalloc (size_t sz) {
+      return _parentHeap->malloc (sz);
+    }
 
+    /// Free to the parent heap, bypassing the local heap and the
+    /// large-object cache.
+    inline void parentFree (void * ptr) {
+      auto * s = getSuperblock (ptr);
+      if (s && s->isValidSuperblock()) {
+	ptr = s->normalize (ptr);
+      } else {
+	auto * b = getBigObject (ptr);
+	if (b) {
+	  ptr = b->normalize (ptr);
+	}
       }
-      // else: Invalid pointer - silently ignore.
+      _parentHeap->free (ptr);
+    }
+
+    /// Free n objects, skipping null pointers. Objects that come from
+    /// the same superblock as the one before them (as they do from
+    /// mallocBatch) share one look at its header.
+    inline void freeBatch (void ** ptrs, size_t n) {
+      SuperblockType * last = nullptr;
+      int c = 0;
+      for (size_t i = 0; i < n; i++) {
+	auto * ptr = ptrs[i];
+	if (ptr == nullptr) {
+	  continue;
+	}
+	auto * s = getSuperblock (ptr);
+	if (s != last) {
+	  if (!(s && s->isValidSuperblock()) || (s->getObjectSize() > LargestObject) || s->isPrivate()) {
+	    last = nullptr;
+	    free (ptr);
+	    continue;
+	  }
+	  last = s;
+	  c = getSizeClass (s->getObjectSize());
+	}
+	if (TLAB_UNLIKELY(getClassSize (c) + _localHeapBytes > LocalHeapThreshold)) {
+	  free (ptr);
+	  continue;
+	}
+	_localHeap(c).insert ((HL::SLList::Entry *) s->normalize (ptr));
+	_localHeapBytes += getClassSize (c);
+      }
+    }
+
+    /// Free an object that malloc was asked for sz bytes of. Its size
+    /// class follows from sz, so small objects go to the local heap
+    /// without a look at their superblock's header, which is likely
+    /// cold when objects are freed far from where they were allocated.
+    /// Only debug builds check that the caller got sz right. Objects
+    /// from a private heap must still go back to it; PrivateSuperblockMap
+    /// tells them apart without reading the header.
+    inline void free (void * ptr, size_t sz) {
+      if (TLAB_LIKELY(sz <= LargestObject)) {
+	auto c = getSizeClass (sz);
+	assert (getSuperblock (ptr) != nullptr);
+	assert (getSuperblock (ptr)->isValidSuperblock());
+	assert (getSuperblock (ptr)->getObjectSize() == getClassSize (c));
+	assert (getSuperblock (ptr)->normalize (ptr) == ptr);
+	assert (!getSuperblock (ptr)->isPrivate()
+		|| PrivateSuperblockMap<SuperblockSize>::contains (ptr));
+	if (TLAB_LIKELY((getClassSize (c) + _localHeapBytes <= LocalHeapThreshold)
+			&& !PrivateSuperblockMap<SuperblockSize>::contains (ptr))) {
+	  _localHeap(c).insert ((HL::SLList::Entry *) ptr);
+	  _localHeapBytes += getClassSize (c);
+	  return;
+	}
+      }
+      free (ptr);
     }
 
     void clear() {
+      _largeCache.clear();
+
       // Free every object to the 'parent' heap.
       int i = NumBins - 1;
       while ((_localHeapBytes > 0) && (i >= 0)) {
@@ -147,6 +309,18 @@ namespace Hoard {
       return SuperblockType::getSuperblock (ptr);
     }
 
+    /// The header of the big object containing ptr, or nullptr if it
+    /// is not in one. Big objects need not have the same kind of
+    /// header as superblocks, so this only means something once
+    /// getSuperblock has come up empty.
+    static inline BigSuperblockType * getBigObject (void * ptr) {
+      auto * b = BigSuperblockType::getSuperblock (ptr);
+      if (b && b->isValidSuperblock()) {
+	return b;
+      }
+      return nullptr;
+    }
+
   private:
 
     // Disable assignment and copying.
@@ -165,6 +339,12 @@ namespace Hoard {
 
     /// The local heap itself.
     Array<NumBins, HL::SLList> _localHeap;
+
+    /// Recently freed objects too large for the local heap.
+    LargeCache _largeCache;
+
+    /// See reallocHistory.
+    ReallocHistoryType _reallocHistory;
   };
 
 }
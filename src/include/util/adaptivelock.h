@@ -0,0 +1,180 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_ADAPTIVELOCK_H
+#define HOARD_ADAPTIVELOCK_H
+
+#include <atomic>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cpurelax.h"
+
+namespace Hoard {
+
+/**
+ * @class AdaptiveLock
+ * @brief A spin-then-park mutex for use when threads may be preempted
+ *        while holding a lock (i.e., when there are more runnable
+ *        threads than cores).
+ *
+ * The lock word follows Drepper's "Futexes Are Tricky" mutex:
+ * 0 = unlocked, 1 = locked, 2 = locked with (possible) waiters.
+ * The uncontended path is a single CAS, just like a spin lock.
+ *
+ * Under contention, a thread first spins with exponential backoff for
+ * up to _spinLimit pause iterations, then sleeps on a futex (Linux) or
+ * yields (elsewhere). The spin limit adapts per lock: the number of
+ * spins a waiter needed before the holder let go is a direct sample of
+ * the lock's remaining hold time, so successful spins pull the limit
+ * toward twice that sample, and each time the spin budget runs out
+ * (the holder was slow or was preempted) the limit shrinks.
+ */
+class AdaptiveLock {
+public:
+
+  AdaptiveLock()
+    : _state (Unlocked),
+      _spinLimit (InitialSpins)
+  {}
+
+  inline void lock() {
+    int expected = Unlocked;
+    if (_state.compare_exchange_strong(expected, Locked,
+				       std::memory_order_acquire,
+				       std::memory_order_relaxed)) {
+      return;
+    }
+    slowLock();
+  }
+
+  /// As lock(), but also returns how many pause iterations it spun
+  /// before getting the lock (for ProfiledLock).
+  inline int lockCountingSpins() {
+    int expected = Unlocked;
+    if (_state.compare_exchange_strong(expected, Locked,
+				       std::memory_order_acquire,
+				       std::memory_order_relaxed)) {
+      return 0;
+    }
+    return slowLock();
+  }
+
+  inline bool try_lock() {
+    int expected = Unlocked;
+    return _state.compare_exchange_strong(expected, Locked,
+					  std::memory_order_acquire,
+					  std::memory_order_relaxed);
+  }
+
+  inline void unlock() {
+    if (_state.exchange(Unlocked, std::memory_order_release) == Contended) {
+      wake();
+    }
+  }
+
+private:
+
+  enum { Unlocked = 0, Locked = 1, Contended = 2 };
+
+  /// Bounds on (and starting point for) the spin budget, in pause iterations.
+  enum { MinSpins = 16, InitialSpins = 256, MaxSpins = 4096 };
+
+  /// The largest single backoff step, in pause iterations.
+  enum { MaxBackoff = 64 };
+
+  /// Returns the number of pause iterations spent spinning.
+  NO_INLINE int slowLock() {
+    const int limit = _spinLimit.load(std::memory_order_relaxed);
+    int spins = 0;
+    int backoff = 1;
+    while (spins < limit) {
+      for (int i = 0; i < backoff; i++) {
+	cpuRelax();
+      }
+      spins += backoff;
+      if (_state.load(std::memory_order_relaxed) == Unlocked) {
+	int expected = Unlocked;
+	if (_state.compare_exchange_weak(expected, Locked,
+					 std::memory_order_acquire,
+					 std::memory_order_relaxed)) {
+	  adapt (limit, limit + (2 * spins - limit) / 8);
+	  return spins;
+	}
+      }
+      if (backoff < MaxBackoff) {
+	backoff *= 2;
+      }
+    }
+
+    // Spinning didn't pay off; shrink the budget and go to sleep.
+    adapt (limit, limit - limit / 8);
+
+    // Whoever takes the lock from here on marks it contended, so the
+    // eventual unlock() knows to wake a sleeper.
+    while (_state.exchange(Contended, std::memory_order_acquire) != Unlocked) {
+      wait (Contended);
+    }
+    return spins;
+  }
+
+  inline void adapt (int oldLimit, int newLimit) {
+    if (newLimit < MinSpins) {
+      newLimit = MinSpins;
+    } else if (newLimit > MaxSpins) {
+      newLimit = MaxSpins;
+    }
+    if (newLimit != oldLimit) {
+      // Racy by design: this is only a heuristic.
+      _spinLimit.store(newLimit, std::memory_order_relaxed);
+    }
+  }
+
+  inline void wait (int val) {
+#if defined(__linux__)
+    syscall (SYS_futex, reinterpret_cast<int *>(&_state),
+	     FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+#else
+    (void) val;
+    std::this_thread::yield();
+#endif
+  }
+
+  inline void wake() {
+#if defined(__linux__)
+    syscall (SYS_futex, reinterpret_cast<int *>(&_state),
+	     FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+  }
+
+
+  static_assert(sizeof(std::atomic<int>) == sizeof(int),
+		"The futex word must be a plain int.");
+
+  /// The lock word (see above).
+  std::atomic<int> _state;
+
+  /// Current spin budget for this lock, in pause iterations.
+  std::atomic<int> _spinLimit;
+};
+
+}
+
+#endif
@@ -24,6 +24,10 @@
 
 #include <unordered_map>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 #include "heaplayers.h"
 #include "mmapalloc.h"
 
@@ -99,6 +103,43 @@ namespace Hoard {
     inline void free (void * ptr, size_t sz) {
       HL::MmapWrapper::unmap (ptr, sz);
     }
+
+    /// Resize a mapping from malloc to newSz bytes. It keeps its address
+    /// if it shrinks or the pages after it are free; otherwise (if
+    /// mayMove) its pages move to a new aligned mapping, without being
+    /// copied. Returns null (leaving the mapping alone) if that fails or
+    /// is unsupported.
+    inline void * resize (void * ptr, size_t oldSz, size_t newSz, bool mayMove = true) {
+#if defined(__linux__) && !TRACK_SIZE
+      oldSz = HL::align<HL::MmapWrapper::Size>(oldSz);
+      newSz = HL::align<HL::MmapWrapper::Size>(newSz);
+      if (oldSz == newSz) {
+	return ptr;
+      }
+      if (mremap (ptr, oldSz, newSz, 0) != MAP_FAILED) {
+	return ptr;
+      }
+      if (!mayMove) {
+	return nullptr;
+      }
+      // Replace a fresh aligned mapping with the old pages.
+      void * dest = malloc (newSz);
+      if (dest == nullptr) {
+	return nullptr;
+      }
+      if (mremap (ptr, oldSz, newSz, MREMAP_MAYMOVE | MREMAP_FIXED, dest) == MAP_FAILED) {
+	free (dest, newSz);
+	return nullptr;
+      }
+      return dest;
+#else
+      (void) ptr;
+      (void) oldSz;
+      (void) newSz;
+      (void) mayMove;
+      return nullptr;
+#endif
+    }
     
 #if 0
     inline void free (void * ptr) {
@@ -198,7 +239,22 @@ namespace Hoard {
   template <size_t Alignment_,
 	    class LockType>
   class AlignedMmap :
-    public ExactlyOneHeap<LockedHeap<LockType, AlignedMmapInstance<Alignment_> > > {};
+    public ExactlyOneHeap<LockedHeap<LockType, AlignedMmapInstance<Alignment_> > > {
+  public:
+
+    /// Like malloc, and sets dirty to how many of the object's leading
+    /// bytes may be nonzero: none, since every mapping is fresh.
+    void * mallocClean (size_t sz, size_t& dirty) {
+      dirty = 0;
+      return this->malloc (sz);
+    }
+
+    /// See AlignedMmapInstance::resize. Instances hold no state (unless
+    /// TRACK_SIZE is on, when resize always fails), so any one will do.
+    static void * resize (void * ptr, size_t oldSz, size_t newSz, bool mayMove = true) {
+      return AlignedMmapInstance<Alignment_>().resize (ptr, oldSz, newSz, mayMove);
+    }
+  };
 
 }
 
@@ -32,6 +32,43 @@ namespace Hoard {
       return Heap::malloc (sz);
     }
 
+    /// Malloc without the lock. Only the heap's exclusive owner may
+    /// call this (see ThreadPoolHeap::malloc).
+    MALLOC_FUNCTION INLINE void * unlockedMalloc (size_t sz) {
+      return Heap::malloc (sz);
+    }
+
+    /// Locked malloc for shared heaps. Returns false (allocating
+    /// nothing) if another thread became this heap's exclusive owner
+    /// while we were waiting for the lock.
+    INLINE bool tryMalloc (size_t sz, void *& ptr) {
+      std::lock_guard<Heap> l (*this);
+      if (Heap::isExclusive()) {
+	return false;
+      }
+      ptr = Heap::malloc (sz);
+      return true;
+    }
+
+    /// Batch versions of the above (see HoardManager::mallocBatch).
+    INLINE size_t mallocBatch (size_t sz, size_t n, void ** ptrs) {
+      std::lock_guard<Heap> l (*this);
+      return Heap::mallocBatch (sz, n, ptrs);
+    }
+
+    INLINE size_t unlockedMallocBatch (size_t sz, size_t n, void ** ptrs) {
+      return Heap::mallocBatch (sz, n, ptrs);
+    }
+
+    INLINE bool tryMallocBatch (size_t sz, size_t n, void ** ptrs, size_t& got) {
+      std::lock_guard<Heap> l (*this);
+      if (Heap::isExclusive()) {
+	return false;
+      }
+      got = Heap::mallocBatch (sz, n, ptrs);
+      return true;
+    }
+
     /// Forward reclaimSuperblock to underlying heap.
     template <typename SuperblockType, typename HeapType>
     void reclaimSuperblock(SuperblockType* s, void* ptr, HeapType* oldOwner) {
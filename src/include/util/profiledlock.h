@@ -0,0 +1,252 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_PROFILEDLOCK_H
+#define HOARD_PROFILEDLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// Build with -DHOARD_LOCK_PROFILING=1 to wrap every lock in the heap
+// stack with ProfiledLock. Recording then starts enabled; set
+// HOARD_LOCK_PROFILE=0 in the environment (or call
+// hoard_lock_profiling(0)) to turn it off at runtime.
+#if !defined(HOARD_LOCK_PROFILING)
+#define HOARD_LOCK_PROFILING 0
+#endif
+
+namespace Hoard {
+
+  /// The lock sites we distinguish, one per layer of the heap stack.
+  namespace LockSite {
+    enum {
+      HeapManager,      // HeapManager::heapLock (heap assignment).
+      PerThreadHeap,    // LockMallocHeap over each per-thread heap.
+      PerThreadBin,     // EmptyClass bin locks in per-thread heaps.
+      GlobalHeap,       // The global ProcessHeap.
+      GlobalBin,        // EmptyClass bin locks in the global heap.
+      BigHeap,          // LockedHeap around ThresholdSegHeap.
+      MediumCache,      // LockedHeap around each SpanCache.
+      MediumHeap,       // LockedHeap around the shared SpanHeap.
+      MmapSource,       // AlignedMmap (fresh superblocks from the OS).
+      PrivateHeap,      // LockMallocHeap over each private heap.
+      PrivateBin,       // EmptyClass bin locks in private heaps.
+      NumSites
+    };
+  }
+
+  /**
+   * @class LockProfile
+   * @brief Contention statistics, aggregated over all locks at a site.
+   */
+  class LockProfile {
+  public:
+
+    /// Wait-time histogram buckets: bucket i counts waits of
+    /// [2^i, 2^(i+1)) ns; the last bucket also takes everything longer.
+    enum { NumBuckets = 24 };
+
+    struct SiteStats {
+      std::atomic<uint64_t> acquisitions { 0 };
+      std::atomic<uint64_t> contended { 0 };
+      std::atomic<uint64_t> spins { 0 };
+      std::atomic<uint64_t> waitNanoseconds { 0 };
+      std::atomic<uint64_t> waitHistogram[NumBuckets] {};
+    };
+
+    static const char * siteName (int site) {
+      static const char * names[LockSite::NumSites] = {
+	"heap-manager",
+	"per-thread-heap",
+	"per-thread-bin",
+	"global-heap",
+	"global-bin",
+	"big-heap",
+	"medium-cache",
+	"medium-heap",
+	"mmap-source",
+	"private-heap",
+	"private-bin"
+      };
+      return names[site];
+    }
+
+    static SiteStats& stats (int site) {
+      static SiteStats theStats[LockSite::NumSites];
+      return theStats[site];
+    }
+
+    static inline bool isEnabled() {
+      return enabledFlag().load(std::memory_order_relaxed);
+    }
+
+    /// Turn recording on or off; returns the previous setting.
+    static bool setEnabled (bool enable) {
+      bool old = isEnabled();
+      enabledFlag().store (enable ? 1 : 0, std::memory_order_relaxed);
+      return old;
+    }
+
+    static void reset() {
+      for (int i = 0; i < LockSite::NumSites; i++) {
+	auto& s = stats(i);
+	s.acquisitions = 0;
+	s.contended = 0;
+	s.spins = 0;
+	s.waitNanoseconds = 0;
+	for (auto& b : s.waitHistogram) {
+	  b = 0;
+	}
+      }
+    }
+
+    static inline void recordWait (SiteStats& s, uint64_t spins, uint64_t ns) {
+      s.contended.fetch_add (1, std::memory_order_relaxed);
+      s.spins.fetch_add (spins, std::memory_order_relaxed);
+      s.waitNanoseconds.fetch_add (ns, std::memory_order_relaxed);
+      int bucket = 0;
+      while ((ns >>= 1) && (bucket < NumBuckets - 1)) {
+	bucket++;
+      }
+      s.waitHistogram[bucket].fetch_add (1, std::memory_order_relaxed);
+    }
+
+    /// Print one line per site that saw any acquisitions.
+    static void dump (FILE * f) {
+      fprintf (f, "Hoard lock profile (site: acquisitions contended spins wait-ns | log2(ns) histogram)\n");
+      for (int i = 0; i < LockSite::NumSites; i++) {
+	auto& s = stats(i);
+	auto acq = s.acquisitions.load();
+	if (acq == 0) {
+	  continue;
+	}
+	fprintf (f, "  %-16s %12llu %10llu %12llu %14llu |",
+		 siteName(i),
+		 (unsigned long long) acq,
+		 (unsigned long long) s.contended.load(),
+		 (unsigned long long) s.spins.load(),
+		 (unsigned long long) s.waitNanoseconds.load());
+	for (auto& b : s.waitHistogram) {
+	  fprintf (f, " %llu", (unsigned long long) b.load());
+	}
+	fprintf (f, "\n");
+      }
+    }
+
+  private:
+
+    static std::atomic<int>& enabledFlag() {
+      // The environment is read once, on first use.
+      static std::atomic<int> flag { initialSetting() };
+      return flag;
+    }
+
+    static int initialSetting() {
+      auto * env = getenv ("HOARD_LOCK_PROFILE");
+      return (env && (env[0] == '0')) ? 0 : 1;
+    }
+  };
+
+  /**
+   * @class ProfiledLock
+   * @brief Wraps a lock and records contention statistics for its site.
+   *
+   * An acquisition counts as contended if the lock was visibly held
+   * when we arrived; its wait time is that of the underlying lock()
+   * call, so the lock waits exactly as it would unprofiled. Spins are
+   * those the underlying lock reports (see
+   * AdaptiveLock::lockCountingSpins); locks that don't count them
+   * report none.
+   */
+  template <class LockType, int Site>
+  class ProfiledLock {
+  public:
+
+    inline void lock() {
+      if (!LockProfile::isEnabled()) {
+	_lock.lock();
+	_held.store (true, std::memory_order_relaxed);
+	return;
+      }
+      auto& s = LockProfile::stats(Site);
+      if (!_held.load(std::memory_order_relaxed)) {
+	_lock.lock();
+	_held.store (true, std::memory_order_relaxed);
+	s.acquisitions.fetch_add (1, std::memory_order_relaxed);
+	return;
+      }
+      auto start = std::chrono::steady_clock::now();
+      auto spins = lockCountingSpins (_lock, 0);
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      _held.store (true, std::memory_order_relaxed);
+      s.acquisitions.fetch_add (1, std::memory_order_relaxed);
+      LockProfile::recordWait (s, spins, (uint64_t) ns);
+    }
+
+    /// Only for locks that have try_lock. A failed attempt is not an
+    /// acquisition, and its caller doesn't wait, so it isn't counted.
+    inline bool try_lock() {
+      if (!_lock.try_lock()) {
+	return false;
+      }
+      _held.store (true, std::memory_order_relaxed);
+      if (LockProfile::isEnabled()) {
+	LockProfile::stats(Site).acquisitions.fetch_add (1, std::memory_order_relaxed);
+      }
+      return true;
+    }
+
+    inline void unlock() {
+      _held.store (false, std::memory_order_relaxed);
+      _lock.unlock();
+    }
+
+  private:
+
+    /// Lock l, returning the spins it reports...
+    template <class L>
+    static inline auto lockCountingSpins (L& l, int) -> decltype(l.lockCountingSpins(), uint64_t()) {
+      return (uint64_t) l.lockCountingSpins();
+    }
+
+    /// ...or none, if it doesn't count them.
+    template <class L>
+    static inline uint64_t lockCountingSpins (L& l, long) {
+      l.lock();
+      return 0;
+    }
+
+    LockType _lock;
+
+    /// Whether some thread currently holds the lock (a hint only).
+    std::atomic<bool> _held { false };
+  };
+
+  /// The lock to use at a given site: ProfiledLock when profiling is
+  /// compiled in, the plain lock otherwise.
+#if HOARD_LOCK_PROFILING
+  template <class LockType, int Site>
+  using SiteLock = ProfiledLock<LockType, Site>;
+#else
+  template <class LockType, int Site>
+  using SiteLock = LockType;
+#endif
+
+}
+
+#endif
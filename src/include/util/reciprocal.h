@@ -0,0 +1,96 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_RECIPROCAL_H
+#define HOARD_RECIPROCAL_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Hoard {
+
+  /**
+   * @class Reciprocal
+   * @brief Division and remainder by a fixed divisor, without a divide.
+   *
+   * Precomputes M = ceil(2^64 / d), after which, for 32-bit n,
+   *   n / d == (M * n) >> 64, and
+   *   n % d == ((M * n mod 2^64) * d) >> 64
+   * (Lemire, Kaser and Kurz, "Faster Remainder by Direct Computation",
+   * 2019). Each is one or two multiplies instead of a 20-90 cycle
+   * divide. This is exact for n and d below 2^32 (and for n == 0),
+   * which covers every offset within a superblock. Big objects can be
+   * 4GB or more, though, so for divisors that large we just divide.
+   */
+  class Reciprocal {
+  public:
+
+    explicit Reciprocal (size_t d)
+      : _multiplier (((d > 1) && (((uint64_t) d >> 32) == 0)) ? (~(uint64_t) 0 / d + 1) : 0),
+	_divisor (d)
+    {
+      assert (d > 1);
+    }
+
+    inline size_t divide (size_t n) const {
+      if (_multiplier == 0) {
+	return (size_t) (n / _divisor);
+      }
+      assert (((uint64_t) n >> 32) == 0);
+      return (size_t) multiplyHigh (_multiplier, n);
+    }
+
+    inline size_t remainder (size_t n) const {
+      if (_multiplier == 0) {
+	return (size_t) (n % _divisor);
+      }
+      assert (((uint64_t) n >> 32) == 0);
+      return (size_t) multiplyHigh (_multiplier * n, _divisor);
+    }
+
+  private:
+
+    /// The high 64 bits of the 128-bit product a * b.
+    static inline uint64_t multiplyHigh (uint64_t a, uint64_t b) {
+#if defined(_MSC_VER) && defined(_M_X64)
+      return __umulh (a, b);
+#elif defined(__SIZEOF_INT128__)
+      return (uint64_t) (((unsigned __int128) a * b) >> 64);
+#else
+      // Schoolbook multiply on 32-bit halves.
+      uint64_t aLo = (uint32_t) a, aHi = a >> 32;
+      uint64_t bLo = (uint32_t) b, bHi = b >> 32;
+      uint64_t lo = aLo * bLo;
+      uint64_t mid1 = aHi * bLo + (lo >> 32);
+      uint64_t mid2 = aLo * bHi + (uint32_t) mid1;
+      return aHi * bHi + (mid1 >> 32) + (mid2 >> 32);
+#endif
+    }
+
+    /// ceil(2^64 / divisor), or 0 if the divisor is 2^32 or more.
+    uint64_t _multiplier;
+
+    /// The divisor.
+    uint64_t _divisor;
+  };
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_SHAREDTHREADHEAP_H
+#define HOARD_SHAREDTHREADHEAP_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+#include "heaplayers.h"
+
+namespace Hoard {
+
+  /**
+   * @class SharedThreadHeap
+   * @brief HL::ThreadHeap, with one set of heaps for every instance.
+   *
+   * Requests go to one of NumHeaps heaps, picked by thread id. Because
+   * the heaps are static, code outside the heap stack that holds an
+   * instance can still reach them; malloc, resize and mallocClean
+   * (which PerThreadHeap runs under its lock) are called that way.
+   */
+
+  template <int NumHeaps, class PerThreadHeap>
+  class SharedThreadHeap {
+  public:
+
+    enum { Alignment = PerThreadHeap::Alignment };
+
+    static inline void * malloc (size_t sz) {
+      return getHeap().malloc (sz);
+    }
+
+    inline void free (void * ptr) {
+      getHeap().free (ptr);
+    }
+
+    inline size_t getSize (void * ptr) {
+      return getHeap().getSize (ptr);
+    }
+
+    static inline size_t goodSize (size_t sz) {
+      return PerThreadHeap::goodSize (sz);
+    }
+
+    static inline void * mallocClean (size_t sz, size_t& dirty) {
+      auto& heap = getHeap();
+      std::lock_guard<PerThreadHeap> l (heap);
+      return heap.mallocClean (sz, dirty);
+    }
+
+    static inline void * resize (void * ptr, size_t sz, bool mayMove = true) {
+      auto& heap = getHeap();
+      std::lock_guard<PerThreadHeap> l (heap);
+      return heap.resize (ptr, sz, mayMove);
+    }
+
+  private:
+
+    static inline PerThreadHeap& getHeap() {
+      alignas(PerThreadHeap) static char buf[NumHeaps * sizeof(PerThreadHeap)];
+      static auto * heaps = initHeaps (buf);
+      return heaps[HL::CPUInfo::getThreadId() % NumHeaps];
+    }
+
+    static PerThreadHeap * initHeaps (char * buf) {
+      auto * heaps = reinterpret_cast<PerThreadHeap *>(buf);
+      for (int i = 0; i < NumHeaps; i++) {
+	new (&heaps[i]) PerThreadHeap;
+      }
+      return heaps;
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_SIZEHISTOGRAM_H
+#define HOARD_SIZEHISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// Build with -DHOARD_SIZE_HISTOGRAM=1 to count every malloc request by
+// size. The histogram is written when the program exits, to the file
+// named by HOARD_SIZE_HISTOGRAM in the environment (or to stderr), in
+// the format read by src/tools/sizeclass-gen.
+#if !defined(HOARD_SIZE_HISTOGRAM)
+#define HOARD_SIZE_HISTOGRAM 0
+#endif
+
+namespace Hoard {
+
+  /**
+   * @class SizeHistogram
+   * @brief Request counts and requested bytes, per Granularity-byte bucket.
+   *
+   * Bucket i holds requests of ((i-1) * Granularity, i * Granularity]
+   * bytes; requests above MaxSize share one overflow bucket. Keeping
+   * the requested bytes as well as the counts lets a consumer compute
+   * exact internal fragmentation for any class boundaries that are
+   * multiples of Granularity.
+   */
+  class SizeHistogram {
+  public:
+
+    static constexpr size_t Granularity = 16;
+    static constexpr size_t MaxSize = 256 * 1024;
+    static constexpr size_t NumBuckets = MaxSize / Granularity + 1;
+
+    static inline void record (size_t sz) {
+      auto& b = bucket ((sz <= MaxSize) ? (sz + Granularity - 1) / Granularity : NumBuckets);
+      b.count.fetch_add (1, std::memory_order_relaxed);
+      b.bytes.fetch_add (sz, std::memory_order_relaxed);
+    }
+
+    /// One "size count bytes" line per non-empty bucket, where size is
+    /// the bucket's upper bound.
+    static void dump (FILE * f) {
+      fprintf (f, "# Hoard size histogram (size count bytes)\n");
+      for (size_t i = 0; i < NumBuckets; i++) {
+	auto& b = bucket (i);
+	auto count = b.count.load();
+	if (count) {
+	  fprintf (f, "%llu %llu %llu\n",
+		   (unsigned long long) i * Granularity,
+		   (unsigned long long) count,
+		   (unsigned long long) b.bytes.load());
+	}
+      }
+      auto& over = bucket (NumBuckets);
+      if (over.count.load()) {
+	fprintf (f, "# larger than %llu: %llu %llu\n",
+		 (unsigned long long) MaxSize,
+		 (unsigned long long) over.count.load(),
+		 (unsigned long long) over.bytes.load());
+      }
+    }
+
+    /// Write the histogram where the environment says to.
+    static void report() {
+      auto * name = getenv ("HOARD_SIZE_HISTOGRAM");
+      FILE * f = (name && *name) ? fopen (name, "w") : nullptr;
+      dump (f ? f : stderr);
+      if (f) {
+	fclose (f);
+      }
+    }
+
+  private:
+
+    struct Bucket {
+      std::atomic<uint64_t> count { 0 };
+      std::atomic<uint64_t> bytes { 0 };
+    };
+
+    static inline Bucket& bucket (size_t i) {
+      // Includes the overflow bucket.
+      static Bucket theBuckets[NumBuckets + 1];
+      return theBuckets[i];
+    }
+  };
+
+}
+
+#endif
@@ -16,10 +16,12 @@
 #ifndef HOARD_THREADPOOLHEAP_H
 #define HOARD_THREADPOOLHEAP_H
 
+#include <atomic>
 #include <cassert>
 
 #include "heaplayers.h"
 #include "array.h"
+#include "threadtoken.h"
 //#include "cpuinfo.h"
 
 namespace Hoard {
@@ -60,9 +62,53 @@ namespace Hoard {
     }
     
     inline void * malloc (size_t sz) {
-      return getHeap().malloc (sz);
+      auto tid = HL::CPUInfo::getThreadId();
+      auto heapno = _tidMap(tid & NumThreadsMask);
+      auto& heap = _heap(heapno);
+      auto owner = heap.getOwnerThreadId();
+      if (owner == currentThreadToken()) {
+	if (getInusemap (heapno) == 1) {
+	  // We are this heap's only user: no locks needed.
+	  return heap.unlockedMalloc (sz);
+	}
+	// Another thread has been assigned this heap since we got it;
+	// drop to shared (locked) mode from now on.
+	heap.setOwnerThreadId (0);
+      } else if (owner != 0) {
+	// Some other thread owns this heap outright (we got here via a
+	// thread id collision, or were never assigned a heap).
+	return _heap(0).malloc (sz);
+      }
+      void * ptr;
+      if (heap.tryMalloc (sz, ptr)) {
+	return ptr;
+      }
+      // The heap went exclusive while we waited for its lock.
+      return _heap(0).malloc (sz);
     }
     
+    /// Put n objects of sz bytes (a superblock class size) into ptrs,
+    /// from this thread's heap, as malloc would; returns how many.
+    inline size_t mallocBatch (size_t sz, size_t n, void ** ptrs) {
+      auto tid = HL::CPUInfo::getThreadId();
+      auto heapno = _tidMap(tid & NumThreadsMask);
+      auto& heap = _heap(heapno);
+      auto owner = heap.getOwnerThreadId();
+      if (owner == currentThreadToken()) {
+	if (getInusemap (heapno) == 1) {
+	  return heap.unlockedMallocBatch (sz, n, ptrs);
+	}
+	heap.setOwnerThreadId (0);
+      } else if (owner != 0) {
+	return _heap(0).mallocBatch (sz, n, ptrs);
+      }
+      size_t got;
+      if (heap.tryMallocBatch (sz, n, ptrs, got)) {
+	return got;
+      }
+      return _heap(0).mallocBatch (sz, n, ptrs);
+    }
+
     inline void free (void * ptr) {
       getHeap().free (ptr);
     }
@@ -84,12 +130,14 @@ namespace Hoard {
       return _tidMap(index); 
     }
     
+    /// Written only under the heap manager's lock, but read without
+    /// it by malloc's check for a single user.
     void setInusemap (int index, int value) {
-      _inUseMap(index) = value;
+      _inUseMap(index).store (value, std::memory_order_release);
     }
     
     int getInusemap (int index) const {
-      return _inUseMap(index);
+      return _inUseMap(index).load (std::memory_order_acquire);
     }
 
     /// @brief Mark a heap as active or inactive (for superblock reclaim).
@@ -102,6 +150,26 @@ namespace Hoard {
       return _heap(index);
     }
 
+    /// @brief Hand a heap to a single thread, which then mallocs from it without locks.
+    void setHeapOwner(int index, ThreadToken tid) {
+      // Heap 0 is where every unassigned thread goes, so it is never exclusive.
+      assert (index != 0);
+      auto& heap = _heap(index);
+      // Taking the lock waits out any thread already inside a locked
+      // malloc on this heap; later arrivals see the owner and back off.
+      heap.lock();
+      heap.setOwnerThreadId (tid);
+      heap.unlock();
+    }
+
+    /// @brief Give up exclusive ownership of a heap (if tid holds it).
+    void releaseHeapOwner(int index, ThreadToken tid) {
+      auto& heap = _heap(index);
+      if (heap.getOwnerThreadId() == tid) {
+	heap.setOwnerThreadId (0);
+      }
+    }
+
 
   private:
     
@@ -109,7 +177,7 @@ namespace Hoard {
     Array<MaxThreads, int> _tidMap;
     
     /// Which heap is in use (a reference count).
-    Array<MaxHeaps, int> _inUseMap;
+    Array<MaxHeaps, std::atomic<int>> _inUseMap;
     
     /// The array of heaps we choose from.
     Array<MaxHeaps, PerThreadHeap> _heap;
@@ -0,0 +1,47 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+#ifndef HOARD_THREADTOKEN_H
+#define HOARD_THREADTOKEN_H
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace Hoard {
+
+  /// Identifies a live thread: no two running threads share a token,
+  /// and no thread's token is 0.
+  typedef uintptr_t ThreadToken;
+
+  /// @brief The calling thread's token.
+  /// @note  HL::CPUInfo::getThreadId() is a hash of this and may
+  ///        collide, so it only picks heaps; heap ownership (which lets
+  ///        a thread skip locks) is keyed on the token instead.
+  inline ThreadToken currentThreadToken() {
+#if defined(_WIN32)
+    return (ThreadToken) GetCurrentThreadId();
+#else
+    return (ThreadToken) pthread_self();
+#endif
+  }
+
+}
+
+#endif
@@ -19,10 +19,15 @@
  * @author Emery Berger <http://www.emeryberger.com>
  */
 
+#include <cerrno>
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <new>
+#include <type_traits>
 
 #include "VERSION.h"
+#include "hoard.h"
 
 #define versionMessage "Using the Hoard memory allocator (http://www.hoard.org), version " HOARD_VERSION_STRING "\n"
 
@@ -64,6 +69,7 @@ volatile bool anyThreadCreated = false;
 #endif
 
 #include "hoardtlab.h"
+#include "sizehistogram.h"
 
 //
 // The base Hoard heap.
@@ -94,6 +100,140 @@ extern bool isCustomHeapInitialized();
 
 #include "wrappers/generic-memalign.cpp"
 
+/// Does ptr start an object from BigHeap? Each of those has a mapping
+/// of its own, with a header at the (superblock-aligned) start.
+static inline bool isBigObject (void * ptr, size_t objSize) {
+  if ((ptr >= initBuffer) && (ptr < initBuffer + MAX_LOCAL_BUFFER_SIZE)) {
+    return false;
+  }
+#if HOARD_MEDIUM_OBJECTS
+  if (Hoard::MediumSpans::isSpan (ptr)) {
+    return false;
+  }
+#endif
+  return (objSize > Hoard::BigObjectSize)
+    && ((size_t) ptr % SUPERBLOCK_SIZE == sizeof(Hoard::BigSuperblockType::Header));
+}
+
+/// The largest objects that do not come from BigHeap.
+#if HOARD_MEDIUM_OBJECTS
+enum { LargestNonBigObject = Hoard::LargestMediumObject };
+#else
+enum { LargestNonBigObject = Hoard::BigObjectSize };
+#endif
+
+/// Objects in superblocks lie at multiples of their class size from a
+/// start with (at least) this alignment: a cache-line color past the
+/// header, if the header is inline. Big objects follow their own
+/// header at the start of their mapping.
+enum { ObjectStartAlignment = gcd<gcd<sizeof(Hoard::SmallSuperblockType::Header),
+				     sizeof(Hoard::BigSuperblockType::Header)>::value,
+				 Hoard::CACHE_LINE_SIZE>::value };
+
+typedef Hoard::SmallSizeClass<Hoard::SmallSuperblockType::Header, SUPERBLOCK_SIZE> SmallClasses;
+
+/// The smallest class of at least sz bytes whose objects are all
+/// aligned to alignment (at most ObjectStartAlignment), or 0 if none:
+/// one whose size is a multiple of the alignment.
+static size_t alignedClassSize (size_t sz, size_t alignment) {
+  if (sz > Hoard::BigObjectSize) {
+    return 0;
+  }
+  for (int c = SmallClasses::getSizeClass (sz); c < SmallClasses::NUM_BINS; c++) {
+    if (SmallClasses::getClassSize (c) % alignment == 0) {
+      return SmallClasses::getClassSize (c);
+    }
+  }
+  return 0;
+}
+
+/// An object of sz bytes aligned to alignment (a power of two), taken
+/// (with allocate, for objects from the heap) from wherever the layout
+/// already guarantees that alignment; null if none does, or memory
+/// runs out.
+static void * alignedMalloc (size_t alignment, size_t sz, void * (*allocate) (size_t) = xxmalloc) {
+  // Keep even empty objects (and interior pointers to them) distinct.
+  if (sz == 0) {
+    sz = 1;
+  }
+  if (alignment <= ObjectStartAlignment) {
+    if (sz <= Hoard::BigObjectSize) {
+      auto classSize = alignedClassSize (sz, alignment);
+      if (classSize != 0) {
+	return allocate (classSize);
+      }
+      sz = Hoard::BigObjectSize + 1;
+    }
+    // Medium objects are page-aligned; big ones follow a header.
+    return allocate (sz);
+  }
+  // Room for an aligned object in a superblock, if it comes to that.
+  size_t padded = sz + alignment - ObjectStartAlignment;
+#if HOARD_MEDIUM_OBJECTS
+  if (alignment <= Hoard::MediumSpans::Alignment) {
+    if ((sz > Hoard::BigObjectSize) && (sz <= Hoard::LargestMediumObject)) {
+      return allocate (sz);
+    }
+    // Page-aligned spans make small aligned objects that waste less.
+    const size_t spanSize = (sz + Hoard::MediumSpans::Alignment - 1) & ~((size_t) Hoard::MediumSpans::Alignment - 1);
+    if ((sz <= Hoard::BigObjectSize) && (spanSize <= padded)) {
+      return Hoard::MediumSpanSource::malloc (sz);
+    }
+  }
+#endif
+  // An interior pointer works as well as the object itself, as long
+  // as it stays within the superblock.
+  auto classSize = (padded > sz) ? alignedClassSize (padded, ObjectStartAlignment) : 0;
+  if (classSize != 0) {
+    auto * ptr = reinterpret_cast<char *>(allocate (classSize));
+    return reinterpret_cast<void *>(((size_t) ptr + alignment - 1) & ~(alignment - 1));
+  }
+  return nullptr;
+}
+
+/// The size that alignedMalloc asks xxmalloc for, for an object of sz
+/// bytes aligned to alignment, or 0 if it returns anything other than
+/// the whole object.
+static inline size_t alignedObjectSize (size_t alignment, size_t sz) {
+  if ((alignment > ObjectStartAlignment) || (sz > Hoard::BigObjectSize)) {
+    return 0;
+  }
+  return alignedClassSize ((sz == 0) ? 1 : sz, alignment);
+}
+
+/// The usable size of the objects that xxmalloc (sz) returns, from the
+/// class tables. Big and medium requests may also get a larger object
+/// that a thread had cached, so for them this is a lower bound.
+static inline size_t goodSize (size_t sz) {
+  if (sz <= Hoard::BigObjectSize) {
+    // ANSIWrapper gives empty requests a (non-tiny) object.
+    if (sz == 0) {
+      sz = Hoard::TinyObjectSize + 1;
+    }
+    return SmallClasses::getClassSize (SmallClasses::getSizeClass (sz));
+  }
+#if HOARD_MEDIUM_OBJECTS
+  if (sz <= Hoard::LargestMediumObject) {
+    return Hoard::MediumSpans::goodSize (sz);
+  }
+#endif
+  return Hoard::BigHeap::goodSize (sz);
+}
+
+/// Malloc from the shared heaps, bypassing this thread's caches.
+static void * sharedMalloc (size_t sz) {
+  auto * heap = getCustomHeap();
+  if (heap == nullptr) {
+    return xxmalloc (sz);
+  }
+  return heap->parentMalloc (sz);
+}
+
+/// The alignment that hoard_allocx flags ask for (1 if none).
+static inline size_t allocxAlignment (int flags) {
+  return (size_t) 1 << (flags & HOARD_ALLOCX_LG_ALIGN_MASK);
+}
+
 extern "C" {
 
 #if defined(__GNUG__) || defined(__clang__)
@@ -103,6 +243,9 @@ extern "C" {
   void * xxmalloc (size_t sz)
 #endif
   {
+#if HOARD_SIZE_HISTOGRAM
+    Hoard::SizeHistogram::record (sz);
+#endif
     // Single TLS lookup - getCustomHeap returns nullptr if not initialized
     auto * heap = getCustomHeap();
     if (heap != nullptr) {
@@ -149,14 +292,113 @@ extern "C" {
     // If heap is null, we're in early init - just leak
   }
 
+  /// Free an object that xxmalloc was asked for sz bytes of.
+  void xxfree_sized (void * ptr, size_t sz)
+  {
+    if (ptr >= initBuffer && ptr < initBuffer + MAX_LOCAL_BUFFER_SIZE) {
+      return;
+    }
+    auto * heap = getCustomHeap();
+    if (heap != nullptr) {
+      heap->free (ptr, sz);
+    }
+  }
+
  
 #if defined(__GNUG__)
   void * xxmemalign (size_t alignment, size_t sz) {
 #else
   void * xxmemalign (size_t alignment, size_t sz) {
 #endif
+#if HOARD_TINY_OBJECTS
+    // Tiny objects are only pointer-aligned.
+    if ((sz <= Hoard::TinyObjectSize) && (alignment > Hoard::TinyObjectSize)) {
+      sz = Hoard::TinyObjectSize + 1;
+    }
+#endif
+    if ((alignment != 0) && ((alignment & (alignment - 1)) == 0)) {
+      void * ptr = alignedMalloc (alignment, sz);
+      if (ptr != nullptr) {
+	return ptr;
+      }
+    }
     return generic_xxmemalign(alignment, sz);
   }
+
+  void * xxcalloc (size_t count, size_t sz) {
+    if ((sz != 0) && (count > (size_t) -1 / sz)) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    sz *= count;
+    // Medium and big objects come straight from the span arenas and
+    // BigHeap, which know what is still zero from the OS; only the
+    // rest needs clearing.
+    void * ptr;
+    size_t dirty = sz;
+    if (sz > LargestNonBigObject) {
+      ptr = Hoard::BigHeap::mallocClean (sz, dirty);
+#if HOARD_MEDIUM_OBJECTS
+    } else if (sz > Hoard::BigObjectSize) {
+      ptr = Hoard::MediumSpanSource::mallocClean (sz, dirty);
+#endif
+    } else {
+      ptr = xxmalloc (sz);
+    }
+    if (ptr == nullptr) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    memset (ptr, 0, (dirty < sz) ? dirty : sz);
+    return ptr;
+  }
+
+  void * xxrealloc (void * ptr, size_t sz) {
+    if (ptr == nullptr) {
+      return xxmalloc (sz);
+    }
+    if (sz == 0) {
+      xxfree (ptr);
+      return nullptr;
+    }
+    auto objSize = xxmalloc_usable_size (ptr);
+    // Don't change size if shrinking by less than half.
+    if ((objSize / 2 < sz) && (sz <= objSize)) {
+      return ptr;
+    }
+    auto& stats = Hoard::TheReallocHistory::stats();
+    // Big objects can grow or shrink in place, or move, without
+    // being copied.
+    if ((sz > LargestNonBigObject) && isBigObject (ptr, objSize)) {
+      void * buf = Hoard::BigHeap::resize (ptr, sz);
+      if (buf != nullptr) {
+	if (sz > objSize) {
+	  stats.resized.fetch_add (1, std::memory_order_relaxed);
+	}
+	return buf;
+      }
+    }
+    // Give objects that keep growing room to grow into.
+    auto * heap = getCustomHeap();
+    int growths = 0;
+    size_t request = sz;
+    if (sz > objSize) {
+      stats.grown.fetch_add (1, std::memory_order_relaxed);
+      if (heap != nullptr) {
+	growths = heap->reallocHistory().take (ptr, objSize) + 1;
+	request = Hoard::TheReallocHistory::request (sz, growths, LargestNonBigObject);
+      }
+    }
+    void * buf = xxmalloc (request);
+    if (buf != nullptr) {
+      memcpy (buf, ptr, (objSize < sz) ? objSize : sz);
+      xxfree (ptr);
+      if (growths > 0) {
+	heap->reallocHistory().put (buf, xxmalloc_usable_size (buf), growths);
+      }
+    }
+    return buf;
+  }
     
   size_t xxmalloc_usable_size (void * ptr) {
     // Handle init buffer pointers
@@ -170,6 +412,208 @@ extern "C" {
     return 0;
   }
 
+  size_t hoard_good_size (size_t sz) {
+    return goodSize (sz);
+  }
+
+  hoard_sized_ptr hoard_malloc_sized (size_t sz) {
+    // Before the heap is up, objects come from the init buffer, and
+    // are exactly as large as requested.
+    if (getCustomHeap() == nullptr) {
+      return { xxmalloc (sz), sz };
+    }
+    void * ptr = xxmalloc (sz);
+    if (sz <= Hoard::BigObjectSize) {
+      return { ptr, goodSize (sz) };
+    }
+    return { ptr, xxmalloc_usable_size (ptr) };
+  }
+
+  __sized_ptr_t __size_returning_new (size_t sz) {
+    return hoard_malloc_sized (sz);
+  }
+
+  size_t hoard_malloc_batch (size_t sz, size_t n, void ** ptrs) {
+#if HOARD_SIZE_HISTOGRAM
+    for (size_t i = 0; i < n; i++) {
+      Hoard::SizeHistogram::record (sz);
+    }
+#endif
+    auto * heap = getCustomHeap();
+    if (heap == nullptr) {
+      for (size_t i = 0; i < n; i++) {
+	ptrs[i] = xxmalloc (sz);
+      }
+      return n;
+    }
+    return heap->mallocBatch (sz, n, ptrs);
+  }
+
+  void hoard_free_batch (void ** ptrs, size_t n) {
+    auto * heap = getCustomHeap();
+    if (heap == nullptr) {
+      return;
+    }
+    // Skip init buffer allocations, freeing the runs between them.
+    size_t start = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (ptrs[i] >= initBuffer && ptrs[i] < initBuffer + MAX_LOCAL_BUFFER_SIZE) {
+	heap->freeBatch (ptrs + start, i - start);
+	start = i + 1;
+      }
+    }
+    heap->freeBatch (ptrs + start, n - start);
+  }
+
+  void * hoard_allocx (size_t sz, int flags) {
+    const auto alignment = allocxAlignment (flags);
+    const bool zero = (flags & HOARD_ALLOCX_ZERO) != 0;
+    const bool noCache = (flags & HOARD_ALLOCX_NO_CACHE) != 0;
+    // calloc takes medium and big objects from the shared heaps, and
+    // only clears what was not fresh from the OS.
+    if (zero && (alignment <= Hoard::MinObjectAlignment)
+	&& !(noCache && (sz <= Hoard::BigObjectSize))) {
+      return xxcalloc (1, sz);
+    }
+    auto * allocate = noCache ? sharedMalloc : xxmalloc;
+    void * ptr;
+    if (alignment <= Hoard::MinObjectAlignment) {
+      ptr = allocate (sz);
+    } else {
+      ptr = alignedMalloc (alignment, sz, allocate);
+      if (ptr == nullptr) {
+	ptr = generic_xxmemalign (alignment, sz);
+      }
+    }
+    if (zero && (ptr != nullptr)) {
+      memset (ptr, 0, sz);
+    }
+    return ptr;
+  }
+
+  size_t hoard_expand (void * ptr, size_t sz) {
+    auto objSize = xxmalloc_usable_size (ptr);
+    if (sz <= objSize) {
+      return objSize;
+    }
+    // Only big objects have room to grow: their mappings can extend.
+    if ((sz > LargestNonBigObject) && isBigObject (ptr, objSize)
+	&& (Hoard::BigHeap::resize (ptr, sz, false) != nullptr)) {
+      return xxmalloc_usable_size (ptr);
+    }
+    return 0;
+  }
+
+  void * hoard_reallocx (void * ptr, size_t sz, int flags) {
+    if (ptr == nullptr) {
+      return hoard_allocx (sz, flags);
+    }
+    if (sz == 0) {
+      sz = 1;
+    }
+    if (flags == 0) {
+      return xxrealloc (ptr, sz);
+    }
+    auto objSize = xxmalloc_usable_size (ptr);
+    if ((size_t) ptr % allocxAlignment (flags) == 0) {
+      // Don't change size if shrinking by less than half.
+      if ((objSize / 2 < sz) && (sz <= objSize)) {
+	return ptr;
+      }
+      if ((sz > objSize) && (hoard_expand (ptr, sz) != 0)) {
+	if (flags & HOARD_ALLOCX_ZERO) {
+	  // The pages past the old mapping are fresh from the OS, but
+	  // the rest of its last page may not be clear.
+	  auto * end = reinterpret_cast<char *>(ptr) + objSize;
+	  size_t tail = HL::align<HL::MmapWrapper::Size>((size_t) end) - (size_t) end;
+	  memset (end, 0, (tail < sz - objSize) ? tail : sz - objSize);
+	}
+	return ptr;
+      }
+    }
+    void * buf = hoard_allocx (sz, flags);
+    if (buf != nullptr) {
+      memcpy (buf, ptr, (objSize < sz) ? objSize : sz);
+      hoard_dallocx (ptr, flags);
+    }
+    return buf;
+  }
+
+  void hoard_dallocx (void * ptr, int flags) {
+    if (!(flags & HOARD_ALLOCX_NO_CACHE)) {
+      xxfree (ptr);
+      return;
+    }
+    if (ptr >= initBuffer && ptr < initBuffer + MAX_LOCAL_BUFFER_SIZE) {
+      return;
+    }
+    // Go straight to the shared heaps (and, for small objects, to
+    // their superblocks' owners), rather than this thread's caches.
+    auto * heap = getCustomHeap();
+    if ((heap != nullptr) && (ptr != nullptr)) {
+      heap->parentFree (ptr);
+    }
+  }
+
+  void hoard_sdallocx (void * ptr, size_t sz, int flags) {
+    if (flags & HOARD_ALLOCX_NO_CACHE) {
+      hoard_dallocx (ptr, flags);
+      return;
+    }
+    // As for aligned sized delete: only objects that hoard_allocx took
+    // whole from a size class have a size that names their class.
+    const auto alignment = allocxAlignment (flags);
+    if (alignment > Hoard::MinObjectAlignment) {
+      sz = alignedObjectSize (alignment, sz);
+      if (sz == 0) {
+	xxfree (ptr);
+	return;
+      }
+    }
+    xxfree_sized (ptr, sz);
+  }
+
+  hoard_heap * hoard_heap_create (void) {
+    void * buf = xxmemalign (alignof(Hoard::PrivateHoardHeap), sizeof(Hoard::PrivateHoardHeap));
+    if (buf == nullptr) {
+      return nullptr;
+    }
+    return reinterpret_cast<hoard_heap *>(new (buf) Hoard::PrivateHoardHeap);
+  }
+
+  void * hoard_heap_alloc (hoard_heap * heap, size_t sz) {
+    if (sz > Hoard::BigObjectSize) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    return reinterpret_cast<Hoard::PrivateHoardHeap *>(heap)->malloc (sz);
+  }
+
+  void hoard_heap_free (hoard_heap * heap, void * ptr) {
+    if (ptr == nullptr) {
+      return;
+    }
+    // Objects from this heap go straight to their superblock's
+    // delayed-free queue (lock-free; the heap drains it when it runs
+    // out of room). Anything else is an ordinary free.
+    auto * h = reinterpret_cast<Hoard::PrivateHoardHeap *>(heap);
+    auto * s = Hoard::PrivateSuperblockType::getSuperblock (ptr);
+    if (s->isValidSuperblock() && s->isPrivate() && (s->getOwner() == h)) {
+      s->pushDelayedFree (s->normalize (ptr));
+    } else {
+      xxfree (ptr);
+    }
+  }
+
+  void hoard_heap_destroy (hoard_heap * heap) {
+    if (heap == nullptr) {
+      return;
+    }
+    auto * h = reinterpret_cast<Hoard::PrivateHoardHeap *>(heap);
+    h->~PrivateHoardHeap();
+    xxfree (h);
+  }
+
   void xxmalloc_lock() {
     // Undefined for Hoard.
   }
@@ -178,9 +622,174 @@ extern "C" {
     // Undefined for Hoard.
   }
 
+  int hoard_lock_stats_get (hoard_lock_stats * stats, int count) {
+#if HOARD_LOCK_PROFILING
+    static_assert((int) Hoard::LockProfile::NumBuckets == HOARD_LOCK_WAIT_BUCKETS,
+		  "Histogram sizes must match.");
+    for (int i = 0; (i < count) && (i < Hoard::LockSite::NumSites); i++) {
+      auto& s = Hoard::LockProfile::stats(i);
+      stats[i].site = Hoard::LockProfile::siteName(i);
+      stats[i].acquisitions = s.acquisitions.load();
+      stats[i].contended = s.contended.load();
+      stats[i].spins = s.spins.load();
+      stats[i].wait_ns = s.waitNanoseconds.load();
+      for (int b = 0; b < HOARD_LOCK_WAIT_BUCKETS; b++) {
+	stats[i].wait_histogram[b] = s.waitHistogram[b].load();
+      }
+    }
+    return Hoard::LockSite::NumSites;
+#else
+    (void) stats;
+    (void) count;
+    return 0;
+#endif
+  }
+
+  void hoard_lock_stats_reset() {
+#if HOARD_LOCK_PROFILING
+    Hoard::LockProfile::reset();
+#endif
+  }
+
+  void hoard_lock_stats_print() {
+#if HOARD_LOCK_PROFILING
+    Hoard::LockProfile::dump (stderr);
+#endif
+  }
+
+  void hoard_realloc_stats_get (hoard_realloc_stats * stats) {
+    auto& s = Hoard::TheReallocHistory::stats();
+    stats->grown = s.grown.load (std::memory_order_relaxed);
+    stats->resized = s.resized.load (std::memory_order_relaxed);
+    stats->promoted = s.promoted.load (std::memory_order_relaxed);
+    stats->headroom_bytes = s.headroomBytes.load (std::memory_order_relaxed);
+  }
+
+  void hoard_realloc_stats_reset() {
+    auto& s = Hoard::TheReallocHistory::stats();
+    s.grown = 0;
+    s.resized = 0;
+    s.promoted = 0;
+    s.headroomBytes = 0;
+  }
+
+  int hoard_lock_profiling (int enable) {
+#if HOARD_LOCK_PROFILING
+    return Hoard::LockProfile::setEnabled (enable != 0);
+#else
+    (void) enable;
+    return -1;
+#endif
+  }
+
 } // namespace Hoard
 
+#if HOARD_LOCK_PROFILING
+// Report lock contention when the program exits.
+static struct LockProfileReporter {
+  ~LockProfileReporter() {
+    if (Hoard::LockProfile::isEnabled()) {
+      Hoard::LockProfile::dump (stderr);
+    }
+  }
+} lockProfileReporter;
+#endif
+
+#if HOARD_SIZE_HISTOGRAM
+// Write out the request-size histogram when the program exits.
+static struct SizeHistogramReporter {
+  ~SizeHistogramReporter() {
+    Hoard::SizeHistogram::report();
+  }
+} sizeHistogramReporter;
+#endif
+
 #if defined(__linux__) && !defined(__MUSL__)
-// include gnuwrapper here to aid inlining of xxmalloc + friends
+// include gnuwrapper here to aid inlining of xxmalloc + friends.
+// Its realloc always copies, and its calloc always clears, so build
+// those under other names and send them to xxrealloc and xxcalloc.
+// The wrapper's own customization point, CUSTOM_PREFIX, renames all
+// of its entry points at once, so rename just these two tokens
+// instead. This relies on gnuwrapper.cpp defining the extern "C"
+// functions realloc and calloc (as CUSTOM_PREFIX(realloc) and
+// CUSTOM_PREFIX(calloc), with the default prefix); the checks below
+// fail to compile if it stops doing so. <cstdlib> is included above,
+// so the C library's own declarations keep their names.
+#define realloc hoard_gnuwrapper_realloc
+#define calloc hoard_gnuwrapper_calloc
 #include "wrappers/gnuwrapper.cpp"
+#undef realloc
+#undef calloc
+
+static_assert(std::is_convertible<decltype(&hoard_gnuwrapper_realloc),
+	      void * (*) (void *, size_t)>::value,
+	      "gnuwrapper.cpp no longer defines realloc.");
+static_assert(std::is_convertible<decltype(&hoard_gnuwrapper_calloc),
+	      void * (*) (size_t, size_t)>::value,
+	      "gnuwrapper.cpp no longer defines calloc.");
+
+extern "C" __attribute__((visibility("default")))
+void * realloc (void * ptr, size_t sz) __THROW {
+  return xxrealloc (ptr, sz);
+}
+
+extern "C" __attribute__((visibility("default")))
+void * calloc (size_t count, size_t sz) __THROW {
+  return xxcalloc (count, sz);
+}
+
+// Sized deletes know the size that new asked malloc for, so the
+// object's size class needs no look at its superblock. Defining them
+// replaces the unsized ones too, so those go straight to xxfree.
+
+__attribute__((visibility("default")))
+void operator delete (void * ptr) noexcept {
+  xxfree (ptr);
+}
+
+__attribute__((visibility("default")))
+void operator delete[] (void * ptr) noexcept {
+  xxfree (ptr);
+}
+
+__attribute__((visibility("default")))
+void operator delete (void * ptr, size_t sz) noexcept {
+  xxfree_sized (ptr, sz);
+}
+
+__attribute__((visibility("default")))
+void operator delete[] (void * ptr, size_t sz) noexcept {
+  xxfree_sized (ptr, sz);
+}
+
+#if defined(__cpp_aligned_new)
+__attribute__((visibility("default")))
+void operator delete (void * ptr, size_t sz, std::align_val_t al) noexcept {
+  auto objSize = alignedObjectSize (static_cast<size_t>(al), sz);
+  if (objSize != 0) {
+    xxfree_sized (ptr, objSize);
+  } else {
+    xxfree (ptr);
+  }
+}
+
+__attribute__((visibility("default")))
+void operator delete[] (void * ptr, size_t sz, std::align_val_t al) noexcept {
+  operator delete (ptr, sz, al);
+}
+#endif
+
+// C23's free_sized takes the size passed to malloc, calloc or realloc,
+// but realloc may keep an object of another size class (or give it
+// room to grow), so these take the checked path.
+
+extern "C" __attribute__((visibility("default")))
+void free_sized (void * ptr, size_t) __THROW {
+  xxfree (ptr);
+}
+
+extern "C" __attribute__((visibility("default")))
+void free_aligned_sized (void * ptr, size_t, size_t) __THROW {
+  xxfree (ptr);
+}
 #endif
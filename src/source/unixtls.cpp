@@ -201,12 +201,13 @@ extern "C" {
 static void exitRoutine() {
   auto * heap = initializeCustomHeap();
 
+  // Clear the heap (via its destructor) while we still own the
+  // assigned heap, so nobody else can be using its bins.
+  heap->~TheCustomHeapType();
+
   // Relinquish the assigned heap.
   getMainHoardHeap()->releaseHeap();
 
-  // Clear the heap (via its destructor).
-  heap->~TheCustomHeapType();
-
 #if !defined(USE_THREAD_KEYWORD)
   // Reclaim the memory associated with the heap (thread-specific data).
   pthread_key_delete (theHeapKey);
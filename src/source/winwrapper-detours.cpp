@@ -31,6 +31,7 @@
 extern "C" {
   void * xxmalloc(size_t);
   void   xxfree(void *);
+  void * xxcalloc(size_t, size_t);
   size_t xxmalloc_usable_size(void *);
   void   xxmalloc_lock(void);
   void   xxmalloc_unlock(void);
@@ -210,11 +211,7 @@ static void __cdecl Detour_free(void * ptr) {
 }
 
 static void * __cdecl Detour_calloc(size_t num, size_t size) {
-  void * ptr = xxmalloc(num * size);
-  if (ptr) {
-    memset(ptr, 0, num * size);
-  }
-  return ptr;
+  return xxcalloc(num, size);
 }
 
 static void * __cdecl Detour_realloc(void * ptr, size_t sz) {
@@ -0,0 +1,131 @@
+/* A smoke test of Hoard's own C API (hoard.h): private heaps,
+ * hoard_reallocx and hoard_expand, and batch allocation. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hoard.h"
+
+static int failures = 0;
+
+#define CHECK(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);	\
+      failures++;							\
+    }									\
+  } while (0)
+
+static int allBytes (const unsigned char * p, size_t n, unsigned char v)
+{
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (p[i] != v) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void testPrivateHeap (void)
+{
+  enum { N = 1000 };
+  unsigned char * objs[N];
+  hoard_heap * heap = hoard_heap_create();
+  int i;
+  CHECK(heap != NULL);
+  if (heap == NULL) {
+    return;
+  }
+  for (i = 0; i < N; i++) {
+    size_t sz = 8 + (size_t) (i % 64) * 16;
+    objs[i] = (unsigned char *) hoard_heap_alloc (heap, sz);
+    CHECK(objs[i] != NULL);
+    memset (objs[i], i & 255, sz);
+  }
+  /* Free every other object, both ways. */
+  for (i = 0; i < N; i += 2) {
+    if (i % 4 == 0) {
+      hoard_heap_free (heap, objs[i]);
+    } else {
+      free (objs[i]);
+    }
+  }
+  for (i = 1; i < N; i += 2) {
+    size_t sz = 8 + (size_t) (i % 64) * 16;
+    CHECK(allBytes (objs[i], sz, (unsigned char) (i & 255)));
+  }
+  /* Far too big for a superblock. */
+  CHECK(hoard_heap_alloc (heap, (size_t) 64 << 20) == NULL);
+  hoard_heap_destroy (heap);
+}
+
+static void testReallocx (void)
+{
+  hoard_sized_ptr s = hoard_malloc_sized (32);
+  unsigned char * p;
+  size_t n;
+  CHECK(s.p != NULL);
+  CHECK(s.n >= 32);
+  memset (s.p, 0xff, s.n);
+  p = (unsigned char *) hoard_reallocx (s.p, 4096, HOARD_ALLOCX_ZERO);
+  CHECK(p != NULL);
+  /* The old contents survive, and everything past them is zero. */
+  CHECK(allBytes (p, s.n, 0xff));
+  CHECK(allBytes (p + s.n, 4096 - s.n, 0));
+
+  /* An object already big enough expands in place; a small one
+     cannot grow into a big one without moving. */
+  n = hoard_expand (p, 100);
+  CHECK(n >= 4096);
+  CHECK(hoard_expand (p, (size_t) 16 << 20) == 0);
+  free (p);
+
+  p = (unsigned char *) hoard_allocx (100, HOARD_ALLOCX_LG_ALIGN(6));
+  CHECK(p != NULL);
+  CHECK(((uintptr_t) p & 63) == 0);
+  hoard_dallocx (p, HOARD_ALLOCX_LG_ALIGN(6));
+
+  /* Big objects may expand in place, but only to at least what we
+     asked for. */
+  p = (unsigned char *) malloc ((size_t) 4 << 20);
+  CHECK(p != NULL);
+  n = hoard_expand (p, (size_t) 8 << 20);
+  CHECK((n == 0) || (n >= ((size_t) 8 << 20)));
+  free (p);
+}
+
+static void testBatch (void)
+{
+  enum { N = 1000 };
+  void * ptrs[N];
+  size_t got = hoard_malloc_batch (48, N, ptrs);
+  size_t i;
+  CHECK(got == N);
+  for (i = 0; i < got; i++) {
+    CHECK(ptrs[i] != NULL);
+    memset (ptrs[i], (int) (i & 255), 48);
+  }
+  for (i = 0; i < got; i++) {
+    CHECK(allBytes ((unsigned char *) ptrs[i], 48, (unsigned char) (i & 255)));
+  }
+  /* Null entries are skipped. */
+  free (ptrs[0]);
+  ptrs[0] = NULL;
+  hoard_free_batch (ptrs, got);
+}
+
+int main (void)
+{
+  testPrivateHeap();
+  testReallocx();
+  testBatch();
+  if (failures) {
+    printf("testapi: %d failures\n", failures);
+    return 1;
+  }
+  printf("testapi: ok\n");
+  return 0;
+}
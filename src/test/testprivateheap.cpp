@@ -0,0 +1,57 @@
+// Sized-delete half of a private heap's objects, destroy the heap,
+// then check that fresh mallocs do not overlap. If the thread's
+// local heap kept any of the deleted objects, they would be handed
+// out again from superblocks that the global heap now owns.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "hoard.h"
+
+using namespace std;
+
+const size_t ObjectSize = 48;
+const int Objects = 20000;
+const int Rounds = 50;
+
+int main()
+{
+  for (int round = 0; round < Rounds; round++) {
+    hoard_heap * heap = hoard_heap_create();
+    if (heap == nullptr) {
+      printf("hoard_heap_create failed\n");
+      return 1;
+    }
+    vector<void *> objs;
+    for (int i = 0; i < Objects; i++) {
+      objs.push_back (hoard_heap_alloc (heap, ObjectSize));
+    }
+    for (size_t i = 0; i < objs.size(); i += 2) {
+      ::operator delete (objs[i], ObjectSize);
+    }
+    hoard_heap_destroy (heap);
+
+    vector<unsigned char *> fresh;
+    for (int i = 0; i < 2 * Objects; i++) {
+      auto * p = (unsigned char *) malloc (ObjectSize);
+      memset (p, i & 255, ObjectSize);
+      fresh.push_back (p);
+    }
+    for (size_t i = 0; i < fresh.size(); i++) {
+      for (size_t k = 0; k < ObjectSize; k++) {
+	if (fresh[i][k] != (i & 255)) {
+	  printf("round %d: object %zu overlaps another\n", round, i);
+	  return 1;
+	}
+      }
+    }
+    for (auto * p : fresh) {
+      free (p);
+    }
+  }
+  printf("testprivateheap: ok\n");
+  return 0;
+}
@@ -0,0 +1,313 @@
+// -*- C++ -*-
+
+/*
+
+  The Hoard Multiprocessor Memory Allocator
+  www.hoard.org
+
+  Author: Emery Berger, http://www.emeryberger.com
+  Copyright (c) 1998-2020 Emery Berger
+
+  See the LICENSE file at the top-level directory of this
+  distribution and at http://github.com/emeryberger/Hoard.
+
+*/
+
+/**
+ * sizeclass-gen: derive Hoard's small-object size classes from a
+ * profile.
+ *
+ * Reads a request-size histogram written by a Hoard built with
+ * -DHOARD_SIZE_HISTOGRAM=1 and writes a header of class sizes that
+ * minimizes internal fragmentation on that profile, using at most the
+ * given number of classes. Build Hoard with
+ * -DHOARD_SIZE_CLASS_TABLE='"path/to/header.h"' to use it.
+ *
+ * Sizes the profile never saw still need sensible classes, so the
+ * table always includes a geometric baseline (every size then wastes
+ * at most the given percentage, plus alignment); the remaining
+ * budget goes where the profile says it pays off. Placement is an
+ * exact dynamic program over the profiled sizes.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "../../include/hoard/hoardconstants.h"
+
+namespace {
+
+  const size_t Alignment = Hoard::ObjectAlignment;
+
+  const size_t LargestSmallObject = Hoard::LargestSmallObject;
+
+  struct Bucket {
+    unsigned long long count = 0;
+    unsigned long long bytes = 0;
+  };
+
+  void usage (const char * argv0) {
+    fprintf (stderr,
+	     "Usage: %s [-n classes] [-b big-object] [-r percent] histogram [output.h]\n"
+	     "  -n  maximum number of size classes (default 128, at most 256)\n"
+	     "  -b  largest class, i.e. Hoard's big-object threshold (default 65536)\n"
+	     "  -r  worst-case overhead of the baseline classes, in percent (default 25)\n",
+	     argv0);
+    exit (1);
+  }
+
+  size_t alignUp (size_t sz) {
+    return (sz + Alignment - 1) & ~(Alignment - 1);
+  }
+
+  /// Reads "size count bytes" lines; '#' starts a comment.
+  std::map<size_t, Bucket> readHistogram (const char * name) {
+    std::map<size_t, Bucket> h;
+    FILE * f = fopen (name, "r");
+    if (!f) {
+      fprintf (stderr, "sizeclass-gen: cannot open %s: %s\n", name, strerror (errno));
+      exit (1);
+    }
+    char line[256];
+    while (fgets (line, sizeof(line), f)) {
+      if (line[0] == '#') {
+	continue;
+      }
+      unsigned long long sz, count, bytes;
+      int n = sscanf (line, "%llu %llu %llu", &sz, &count, &bytes);
+      if (n < 2) {
+	continue;
+      }
+      if (n == 2) {
+	// No byte totals: assume every request was the full bucket size.
+	bytes = sz * count;
+      }
+      auto& b = h[alignUp ((size_t) sz)];
+      b.count += count;
+      b.bytes += bytes;
+    }
+    fclose (f);
+    return h;
+  }
+
+  /// Bytes wasted on the profile if requests are served by classes.
+  double waste (const std::map<size_t, Bucket>& h, const std::vector<size_t>& classes) {
+    double w = 0;
+    for (auto& e : h) {
+      auto it = std::lower_bound (classes.begin(), classes.end(), e.first);
+      if (it != classes.end()) {
+	w += (double) *it * e.second.count - (double) e.second.bytes;
+      }
+    }
+    return w;
+  }
+
+  /// Hoard's default classes (see SmallSizeClassSizes).
+  std::vector<size_t> defaultClasses (size_t bigObject) {
+    std::vector<size_t> c;
+    size_t sz = 0;
+    while (sz < bigObject) {
+      size_t n;
+      if (sz < LargestSmallObject) {
+	n = sz + Alignment;
+      } else {
+	n = sz + (sz * 20) / 100;
+	n -= n % Alignment;
+	if (n <= sz) {
+	  n = sz + Alignment;
+	}
+      }
+      sz = std::min (n, bigObject);
+      c.push_back (sz);
+    }
+    return c;
+  }
+
+  /// Classes growing by at most percent, ending at bigObject.
+  std::vector<size_t> baselineClasses (size_t bigObject, size_t percent) {
+    std::vector<size_t> c;
+    size_t sz = Alignment;
+    while (sz < bigObject) {
+      c.push_back (sz);
+      size_t n = (sz + (sz * percent) / 100) & ~(Alignment - 1);
+      sz = std::max (n, sz + Alignment);
+    }
+    c.push_back (bigObject);
+    return c;
+  }
+
+  /// Choose at most budget classes among the baseline and the
+  /// profiled sizes, keeping every baseline class, to minimize waste.
+  std::vector<size_t> optimize (const std::map<size_t, Bucket>& h,
+				const std::vector<size_t>& baseline,
+				size_t budget)
+  {
+    // Candidate points, in order; point 0 is a sentinel at size 0.
+    std::vector<size_t> point { 0 };
+    std::vector<bool> required { true };
+    {
+      std::map<size_t, bool> all;
+      for (auto& e : h) {
+	if (e.first <= baseline.back()) {
+	  all[e.first] = false;
+	}
+      }
+      for (auto sz : baseline) {
+	all[sz] = true;
+      }
+      for (auto& e : all) {
+	point.push_back (e.first);
+	required.push_back (e.second);
+      }
+    }
+    const size_t P = point.size() - 1;
+    if (P <= budget) {
+      return std::vector<size_t> (point.begin() + 1, point.end());
+    }
+
+    // Prefix sums of counts and bytes, so the waste of serving every
+    // size in (point[i], point[j]] with class point[j] is O(1).
+    std::vector<double> count (P + 1, 0), bytes (P + 1, 0);
+    for (size_t j = 1; j <= P; j++) {
+      auto it = h.find (point[j]);
+      count[j] = count[j-1] + ((it != h.end()) ? (double) it->second.count : 0);
+      bytes[j] = bytes[j-1] + ((it != h.end()) ? (double) it->second.bytes : 0);
+    }
+    auto cost = [&](size_t i, size_t j) {
+      return (double) point[j] * (count[j] - count[i]) - (bytes[j] - bytes[i]);
+    };
+
+    // A class at point j may only follow one at point i if no
+    // required point lies strictly between them.
+    std::vector<size_t> lastRequired (P + 1, 0);
+    for (size_t j = 1; j <= P; j++) {
+      lastRequired[j] = required[j-1] ? j - 1 : lastRequired[j-1];
+    }
+
+    // best[k][j]: least waste for sizes up to point[j], using k
+    // classes with the last at point[j].
+    const double Inf = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> best (budget + 1, std::vector<double> (P + 1, Inf));
+    std::vector<std::vector<size_t>> from (budget + 1, std::vector<size_t> (P + 1, 0));
+    best[0][0] = 0;
+    for (size_t k = 1; k <= budget; k++) {
+      for (size_t j = 1; j <= P; j++) {
+	for (size_t i = lastRequired[j]; i < j; i++) {
+	  if (best[k-1][i] == Inf) {
+	    continue;
+	  }
+	  auto c = best[k-1][i] + cost (i, j);
+	  if (c < best[k][j]) {
+	    best[k][j] = c;
+	    from[k][j] = i;
+	  }
+	}
+      }
+    }
+
+    std::vector<size_t> classes;
+    for (size_t k = budget, j = P; k > 0; j = from[k][j], k--) {
+      classes.push_back (point[j]);
+    }
+    std::reverse (classes.begin(), classes.end());
+    return classes;
+  }
+
+}
+
+int main (int argc, char * argv[]) {
+  size_t budget = 128;
+  size_t bigObject = 65536;
+  size_t percent = 25;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+    if (i + 1 >= argc) {
+      usage (argv[0]);
+    }
+    switch (argv[i][1]) {
+    case 'n': budget = strtoul (argv[++i], nullptr, 10); break;
+    case 'b': bigObject = strtoul (argv[++i], nullptr, 10); break;
+    case 'r': percent = strtoul (argv[++i], nullptr, 10); break;
+    default: usage (argv[0]);
+    }
+  }
+  if ((i >= argc) || (i + 2 < argc)) {
+    usage (argv[0]);
+  }
+  if ((budget == 0) || (budget > 256)) {
+    fprintf (stderr, "sizeclass-gen: the class count must be between 1 and 256.\n");
+    return 1;
+  }
+  if ((bigObject < LargestSmallObject) || (bigObject % Alignment)) {
+    fprintf (stderr, "sizeclass-gen: the largest class must be a multiple of %zu, at least %zu.\n",
+	     Alignment, LargestSmallObject);
+    return 1;
+  }
+  if (percent == 0) {
+    fprintf (stderr, "sizeclass-gen: the baseline overhead must be positive.\n");
+    return 1;
+  }
+
+  const char * input = argv[i];
+  auto h = readHistogram (input);
+  auto baseline = baselineClasses (bigObject, percent);
+  if (baseline.size() > budget) {
+    fprintf (stderr, "sizeclass-gen: the baseline alone needs %zu classes; raise -n or -r.\n",
+	     baseline.size());
+    return 1;
+  }
+  auto classes = optimize (h, baseline, budget);
+
+  // Only requests that will land in superblocks count.
+  double requested = 0;
+  unsigned long long big = 0;
+  for (auto& e : h) {
+    if (e.first <= bigObject) {
+      requested += (double) e.second.bytes;
+    } else {
+      big += e.second.count;
+    }
+  }
+  auto pct = [&](double w) { return (requested > 0) ? 100.0 * w / requested : 0.0; };
+  double tunedWaste = pct (waste (h, classes));
+  double defaultWaste = pct (waste (h, defaultClasses (bigObject)));
+  fprintf (stderr, "sizeclass-gen: %zu classes, internal fragmentation %.2f%% (default classes: %.2f%%)",
+	   classes.size(), tunedWaste, defaultWaste);
+  if (big) {
+    fprintf (stderr, "; %llu larger requests ignored", big);
+  }
+  fprintf (stderr, "\n");
+
+  FILE * out = stdout;
+  if (i + 1 < argc) {
+    out = fopen (argv[i + 1], "w");
+    if (!out) {
+      fprintf (stderr, "sizeclass-gen: cannot write %s: %s\n", argv[i + 1], strerror (errno));
+      return 1;
+    }
+  }
+  fprintf (out,
+	   "// -*- C++ -*-\n\n"
+	   "// Generated by sizeclass-gen from %s; do not edit.\n"
+	   "// %zu classes; internal fragmentation on the profile %.2f%% (default classes: %.2f%%).\n\n"
+	   "#ifndef HOARD_GENERATED_SIZECLASSES_H\n"
+	   "#define HOARD_GENERATED_SIZECLASSES_H\n\n"
+	   "#include <cstddef>\n\n"
+	   "namespace Hoard {\n\n"
+	   "  constexpr size_t generatedSizeClasses[] = {",
+	   input, classes.size(), tunedWaste, defaultWaste);
+  for (size_t c = 0; c < classes.size(); c++) {
+    fprintf (out, "%s%zu", (c % 8) ? ", " : (c ? ",\n    " : "\n    "), classes[c]);
+  }
+  fprintf (out, "\n  };\n\n}\n\n#endif\n");
+  if (out != stdout) {
+    fclose (out);
+  }
+  return 0;
+}